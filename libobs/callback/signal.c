@@ -32,6 +32,9 @@ struct signal_info {
 	pthread_mutex_t                mutex;
 	bool                           signalling;
 
+	/* connected callbacks not marked for removal, updated under mutex */
+	volatile long                  num_callbacks;
+
 	struct signal_info             *next;
 };
 
@@ -50,6 +53,7 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 	si->func       = *info;
 	si->next       = NULL;
 	si->signalling = false;
+	si->num_callbacks = 0;
 	da_init(si->callbacks);
 
 	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
@@ -197,8 +201,15 @@ void signal_handler_connect(signal_handler_t *handler, const char *signal,
 	pthread_mutex_lock(&sig->mutex);
 
 	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx == DARRAY_INVALID)
+	if (idx == DARRAY_INVALID) {
 		da_push_back(sig->callbacks, &cb_data);
+		os_atomic_inc_long(&sig->num_callbacks);
+
+	} else if (sig->callbacks.array[idx].remove) {
+		/* disconnected and reconnected from within the signal */
+		sig->callbacks.array[idx].remove = false;
+		os_atomic_inc_long(&sig->num_callbacks);
+	}
 	
 	pthread_mutex_unlock(&sig->mutex);
 }
@@ -230,21 +241,31 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 	pthread_mutex_lock(&sig->mutex);
 
 	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
+	if (idx != DARRAY_INVALID && !sig->callbacks.array[idx].remove) {
 		if (sig->signalling)
 			sig->callbacks.array[idx].remove = true;
 		else
 			da_erase(sig->callbacks, idx);
+
+		os_atomic_dec_long(&sig->num_callbacks);
 	}
 	
 	pthread_mutex_unlock(&sig->mutex);
 }
 
-void signal_handler_signal(signal_handler_t *handler, const char *signal,
-		calldata_t *params)
+struct signal_info *signal_handler_get_signal(signal_handler_t *handler,
+		const char *signal)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	return getsignal_locked(handler, signal);
+}
 
+bool signal_has_callbacks(struct signal_info *sig)
+{
+	return sig && os_atomic_load_long(&sig->num_callbacks) != 0;
+}
+
+void signal_signal(struct signal_info *sig, calldata_t *params)
+{
 	if (!sig)
 		return;
 
@@ -253,7 +274,8 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 
 	for (size_t i = 0; i < sig->callbacks.num; i++) {
 		struct signal_callback *cb = sig->callbacks.array+i;
-		cb->callback(cb->data, params);
+		if (!cb->remove)
+			cb->callback(cb->data, params);
 	}
 
 	for (size_t i = sig->callbacks.num; i > 0; i--) {
@@ -265,3 +287,9 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 	sig->signalling = false;
 	pthread_mutex_unlock(&sig->mutex);
 }
+
+void signal_handler_signal(signal_handler_t *handler, const char *signal,
+		calldata_t *params)
+{
+	signal_signal(getsignal_locked(handler, signal), params);
+}
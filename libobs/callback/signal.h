@@ -32,6 +32,7 @@ extern "C" {
  */
 
 struct signal_handler;
+struct signal_info;
 typedef struct signal_handler signal_handler_t;
 typedef void (*signal_callback_t)(void*, calldata_t*);
 
@@ -63,6 +64,22 @@ EXPORT void signal_handler_disconnect(signal_handler_t *handler,
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal,
 		calldata_t *params);
 
+/**
+ * Looks up a declared signal once, for signals that are emitted often.  The
+ * result stays valid for as long as the signal handler.
+ */
+EXPORT struct signal_info *signal_handler_get_signal(signal_handler_t *handler,
+		const char *signal);
+
+/**
+ * Returns whether anything is connected to a signal without taking any lock,
+ * so that signals that are expensive to build can be skipped when nobody
+ * listens.
+ */
+EXPORT bool signal_has_callbacks(struct signal_info *signal);
+
+EXPORT void signal_signal(struct signal_info *signal, calldata_t *params);
+
 #ifdef __cplusplus
 }
 #endif
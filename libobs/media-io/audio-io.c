@@ -24,32 +24,60 @@
 #include "../util/platform.h"
 
 #include "audio-io.h"
+#include "audio-mix-internal.h"
 #include "audio-resampler.h"
 
 /* #define DEBUG_AUDIO */
 
 #define nop() do {int invalid = 0;} while(0)
 
+/* inputs of a mix that want the same conversion share one of these, so the
+ * mix is only resampled once per conversion no matter how many inputs */
+struct audio_conversion {
+	struct audio_convert_info info;
+	audio_resampler_t         *resampler;
+	long                      refs;
+
+	/* output of the packet currently being sent to the mix's inputs */
+	struct audio_data         data;
+	bool                      resampled;
+	bool                      success;
+};
+
 struct audio_input {
 	struct audio_convert_info conversion;
-	audio_resampler_t         *resampler;
+	struct audio_conversion   *convert;
 
 	audio_output_callback_t callback;
 	void *param;
 };
 
-static inline void audio_input_free(struct audio_input *input)
-{
-	audio_resampler_destroy(input->resampler);
-}
+/* number of packets that can be queued on a line between mixer ticks, must be
+ * a power of two */
+#define AUDIO_LINE_QUEUE_SIZE 128
+
+struct audio_line_packet {
+	DARRAY(uint8_t)            data[MAX_AV_PLANES];
+	uint32_t                   frames;
+	uint64_t                   timestamp;
+};
 
 struct audio_line {
 	char                       *name;
 
 	struct audio_output        *audio;
+
+	/* single producer/single consumer queue of packets output to the line.
+	 * audio_line_output fills packets (with volume already applied) and
+	 * the audio thread places them in the line's buffers before mixing,
+	 * so neither side ever has to wait on the other */
+	struct audio_line_packet   queue[AUDIO_LINE_QUEUE_SIZE];
+	volatile long              queue_write;
+	volatile long              queue_read;
+	bool                       queue_overflow;
+
+	/* everything below is only touched by the audio thread */
 	struct circlebuf           buffers[MAX_AV_PLANES];
-	pthread_mutex_t            mutex;
-	DARRAY(uint8_t)            volume_buffers[MAX_AV_PLANES];
 	uint64_t                   base_timestamp;
 	uint64_t                   last_timestamp;
 
@@ -59,8 +87,8 @@ struct audio_line {
 	uint32_t                   mixers;
 
 	/* states whether this line is still being used.  if not, then when the
-	 * buffer is depleted, it's destroyed */
-	bool                       alive;
+	 * queue and buffer are depleted, it's destroyed */
+	volatile long              alive;
 
 	struct audio_line          **prev_next;
 	struct audio_line          *next;
@@ -68,19 +96,52 @@ struct audio_line {
 
 static inline void audio_line_destroy_data(struct audio_line *line)
 {
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		circlebuf_free(&line->buffers[i]);
-		da_free(line->volume_buffers[i]);
+
+	for (size_t i = 0; i < AUDIO_LINE_QUEUE_SIZE; i++) {
+		struct audio_line_packet *packet = &line->queue[i];
+
+		for (size_t j = 0; j < MAX_AV_PLANES; j++)
+			da_free(packet->data[j]);
 	}
 
-	pthread_mutex_destroy(&line->mutex);
 	bfree(line->name);
 	bfree(line);
 }
 
+struct audio_mix_packet {
+	uint64_t                   timestamp;
+	uint32_t                   frames;
+};
+
 struct audio_mix {
+	struct audio_output        *audio;
+	size_t                     idx;
+
+	pthread_mutex_t            input_mutex;
 	DARRAY(struct audio_input) inputs;
+	DARRAY(struct audio_conversion*) conversions;
 	DARRAY(uint8_t)            mix_buffers[MAX_AV_PLANES];
+
+	/* each mix sends its audio to its inputs (resamplers, encoders) on its
+	 * own thread, so one slow track can't hold up the other tracks or the
+	 * audio thread.  mixed audio is queued as an audio_mix_packet followed
+	 * by the data of each plane.  the thread is only started once the
+	 * first input connects to the mix */
+	pthread_t                  thread;
+	bool                       thread_initialized;
+	os_sem_t                   *output_sem;
+	pthread_mutex_t            output_mutex;
+	struct circlebuf           output_queue;
+	size_t                     output_queue_frames;
+	bool                       output_overflow;
+	DARRAY(uint8_t)            output_buffers[MAX_AV_PLANES];
+
+	/* byte range of each plane that was clamped while mixing in the last
+	 * line routed to this mix */
+	size_t                     clamped_start[MAX_AV_PLANES];
+	size_t                     clamped_end[MAX_AV_PLANES];
 };
 
 struct audio_output {
@@ -91,15 +152,20 @@ struct audio_output {
 
 	pthread_t                  thread;
 	os_event_t                 *stop_event;
+	uint64_t                   period_ns;
+
+	/* virtual clock used in offline mode */
+	pthread_mutex_t            clock_mutex;
+	os_sem_t                   *clock_sem;
+	uint64_t                   clock_time;
 
 	bool                       initialized;
 
 	pthread_mutex_t            line_mutex;
 	struct audio_line          *first_line;
 
-	pthread_mutex_t            input_mutex;
-
 	struct audio_mix           mixes[MAX_AUDIO_MIXES];
+	struct audio_mix_funcs     mix_funcs;
 };
 
 static inline void audio_output_removeline(struct audio_output *audio,
@@ -192,42 +258,66 @@ static inline size_t min_size(size_t a, size_t b)
 	((val > maxval) ? maxval : ((val < minval) ? minval : val))
 #endif
 
-#define MIX_BUFFER_SIZE 256
-
-/* TODO: optimize mixing */
+/* mixes straight from the line's circlebuf.  the last line routed to a mix
+ * clamps as it adds, so clamp_audio_output only has to do what it missed */
 static void mix_float(struct audio_output *audio, struct audio_line *line,
-		size_t size, size_t time_offset, size_t plane)
+		size_t size, size_t time_offset, size_t plane,
+		uint32_t mixes, uint32_t clamp_mixes)
 {
-	float *mixes[MAX_AUDIO_MIXES];
-	float vals[MIX_BUFFER_SIZE];
+	struct circlebuf *buf = &line->buffers[plane];
+	const uint8_t *segments[2];
+	size_t segment_sizes[2];
 
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		uint8_t *bytes = audio->mixes[mix_idx].mix_buffers[plane].array;
-		mixes[mix_idx] = (float*)&bytes[time_offset];
+	if (!size)
+		return;
+	if (!mixes) {
+		circlebuf_pop_front(buf, NULL, size);
+		return;
 	}
 
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
+	segments[0]      = (uint8_t*)buf->data + buf->start_pos;
+	segment_sizes[0] = min_size(size, buf->capacity - buf->start_pos);
+	segments[1]      = buf->data;
+	segment_sizes[1] = size - segment_sizes[0];
 
-		circlebuf_pop_front(&line->buffers[plane], vals, pop_count);
-		pop_count /= sizeof(float);
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		struct audio_mix *mix = &audio->mixes[mix_idx];
+		uint32_t mix_bit = 1 << mix_idx;
+		bool clamp = (clamp_mixes & mix_bit) != 0;
+		uint8_t *dst;
 
-		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-			/* only include this audio line in this mix if it's set
-			 * via the line's 'mixes' variable */
-			if ((line->mixers & (1 << mix_idx)) == 0)
-				continue;
+		/* only include this audio line in the active mixes it's
+		 * routed to via the line's 'mixers' variable */
+		if ((mixes & mix_bit) == 0)
+			continue;
 
-			for (size_t i = 0; i < pop_count; i++) {
-				*(mixes[mix_idx]++) += vals[i];
-			}
+		dst = mix->mix_buffers[plane].array + time_offset;
+
+		for (size_t i = 0; i < 2; i++) {
+			const float *src = (const float*)segments[i];
+			size_t count = segment_sizes[i] / sizeof(float);
+
+			if (clamp)
+				audio->mix_funcs.add_clamp((float*)dst, src,
+						count);
+			else
+				audio->mix_funcs.add((float*)dst, src, count);
+
+			dst += segment_sizes[i];
+		}
+
+		if (clamp) {
+			mix->clamped_start[plane] = time_offset;
+			mix->clamped_end[plane]   = time_offset + size;
 		}
 	}
+
+	circlebuf_pop_front(buf, NULL, size);
 }
 
 static inline bool mix_audio_line(struct audio_output *audio,
-		struct audio_line *line, size_t size, uint64_t timestamp)
+		struct audio_line *line, size_t size, uint64_t timestamp,
+		uint32_t mixes, uint32_t clamp_mixes)
 {
 	size_t time_offset = ts_diff_bytes(audio,
 			line->base_timestamp, timestamp);
@@ -243,25 +333,26 @@ static inline bool mix_audio_line(struct audio_output *audio,
 	for (size_t i = 0; i < audio->planes; i++) {
 		size_t pop_size = min_size(size, line->buffers[i].size);
 
-		mix_float(audio, line, pop_size, time_offset, i);
+		mix_float(audio, line, pop_size, time_offset, i, mixes,
+				clamp_mixes);
 	}
 
 	return true;
 }
 
-static bool resample_audio_output(struct audio_input *input,
+static bool resample_audio_output(struct audio_conversion *convert,
 		struct audio_data *data)
 {
 	bool success = true;
 
-	if (input->resampler) {
+	if (convert->resampler) {
 		uint8_t  *output[MAX_AV_PLANES];
 		uint32_t frames;
 		uint64_t offset;
 
 		memset(output, 0, sizeof(output));
 
-		success = audio_resampler_resample(input->resampler,
+		success = audio_resampler_resample(convert->resampler,
 				output, &frames, &offset,
 				(const uint8_t *const *)data->data,
 				data->frames);
@@ -275,56 +366,267 @@ static bool resample_audio_output(struct audio_input *input,
 	return success;
 }
 
-static inline void do_audio_output(struct audio_output *audio,
-		size_t mix_idx, uint64_t timestamp, uint32_t frames)
+static inline void do_audio_output(struct audio_mix *mix,
+		const struct audio_mix_packet *packet)
 {
-	struct audio_mix *mix = &audio->mixes[mix_idx];
 	struct audio_data data;
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		data.data[i] = mix->mix_buffers[i].array;
+		data.data[i] = mix->output_buffers[i].array;
 
-	data.frames = frames;
-	data.timestamp = timestamp;
+	data.frames = packet->frames;
+	data.timestamp = packet->timestamp;
 	data.volume = 1.0f;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	pthread_mutex_lock(&mix->input_mutex);
+
+	for (size_t i = 0; i < mix->conversions.num; i++)
+		mix->conversions.array[i]->resampled = false;
 
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array+(i-1);
+		struct audio_conversion *convert = input->convert;
+		struct audio_data output;
+
+		if (!convert->resampled) {
+			convert->data      = data;
+			convert->success   = resample_audio_output(convert,
+					&convert->data);
+			convert->resampled = true;
+		}
+
+		if (!convert->success)
+			continue;
+
+		output = convert->data;
+		input->callback(input->param, mix->idx, &output);
+	}
+
+	pthread_mutex_unlock(&mix->input_mutex);
+}
+
+static bool pop_mix_packet(struct audio_mix *mix,
+		struct audio_mix_packet *packet)
+{
+	struct audio_output *audio = mix->audio;
+	bool success = false;
+
+	pthread_mutex_lock(&mix->output_mutex);
+
+	if (mix->output_queue.size) {
+		size_t size;
+
+		circlebuf_pop_front(&mix->output_queue, packet,
+				sizeof(*packet));
+		size = packet->frames * audio->block_size;
+		mix->output_queue_frames -= packet->frames;
+
+		for (size_t i = 0; i < audio->planes; i++) {
+			da_resize(mix->output_buffers[i], size);
+			circlebuf_pop_front(&mix->output_queue,
+					mix->output_buffers[i].array, size);
+		}
 
-		if (resample_audio_output(input, &data))
-			input->callback(input->param, mix_idx, &data);
+		success = true;
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	pthread_mutex_unlock(&mix->output_mutex);
+	return success;
 }
 
-static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
+static void *audio_mix_thread(void *param)
 {
-	size_t float_size = bytes / sizeof(float);
+	struct audio_mix *mix = param;
+	struct audio_output *audio = mix->audio;
+
+	os_set_thread_name("audio-io: mix output thread");
+
+	while (os_sem_wait(mix->output_sem) == 0) {
+		struct audio_mix_packet packet;
+
+		if (os_event_try(audio->stop_event) != EAGAIN)
+			break;
+
+		if (pop_mix_packet(mix, &packet))
+			do_audio_output(mix, &packet);
+	}
+
+	return NULL;
+}
+
+/* the most audio that can wait on a mix's output thread, so that an output
+ * that stalls (a blocked encoder for example) can't make the queue grow
+ * without bound */
+static inline size_t max_queued_frames(const struct audio_output *audio)
+{
+	uint32_t ms = audio->info.buffer_ms > audio->info.period_ms ?
+		audio->info.buffer_ms : audio->info.period_ms;
+
+	return (size_t)ms * audio->info.samples_per_sec / 1000;
+}
+
+/* hands the mixed audio off to the mix's output thread */
+static void queue_mix_output(struct audio_output *audio,
+		struct audio_mix *mix, uint64_t timestamp, uint32_t frames)
+{
+	struct audio_mix_packet packet = {timestamp, frames};
+	size_t size = frames * audio->block_size;
+
+	pthread_mutex_lock(&mix->output_mutex);
+
+	if (mix->output_queue_frames + frames > max_queued_frames(audio)) {
+		if (!mix->output_overflow)
+			blog(LOG_WARNING, "Audio mix %d output queue is full, "
+			                  "dropping audio until its outputs "
+			                  "catch up", (int)mix->idx);
+		mix->output_overflow = true;
+		pthread_mutex_unlock(&mix->output_mutex);
+		return;
+	}
+
+	mix->output_overflow      = false;
+	mix->output_queue_frames += frames;
 
+	circlebuf_push_back(&mix->output_queue, &packet, sizeof(packet));
+	for (size_t i = 0; i < audio->planes; i++)
+		circlebuf_push_back(&mix->output_queue,
+				mix->mix_buffers[i].array, size);
+
+	pthread_mutex_unlock(&mix->output_mutex);
+
+	os_sem_post(mix->output_sem);
+}
+
+static inline void clamp_audio_output(struct audio_output *audio,
+		uint32_t active_mixes, size_t bytes)
+{
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		/* do not process mixing if a specific mix is inactive */
-		if (!mix->inputs.num)
+		if ((active_mixes & (1 << mix_idx)) == 0)
 			continue;
 
 		for (size_t plane = 0; plane < audio->planes; plane++) {
-			float *mix_data = (float*)mix->mix_buffers[plane].array;
-			float *mix_end = &mix_data[float_size];
-
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val >  1.0f) ?  1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
-			}
+			uint8_t *mix_data = mix->mix_buffers[plane].array;
+			size_t start = mix->clamped_start[plane];
+			size_t end   = mix->clamped_end[plane];
+
+			audio->mix_funcs.clamp((float*)mix_data,
+					start / sizeof(float));
+			audio->mix_funcs.clamp((float*)(mix_data + end),
+					(bytes - end) / sizeof(float));
 		}
 	}
 }
 
+static void audio_line_place_data_pos(struct audio_line *line,
+		const struct audio_line_packet *packet, size_t position)
+{
+	size_t total_size = packet->frames * line->audio->block_size;
+
+	for (size_t i = 0; i < line->audio->planes; i++)
+		circlebuf_place(&line->buffers[i], position,
+				packet->data[i].array, total_size);
+}
+
+static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
+{
+	if (!line->next_ts_min)
+		return timestamp;
+
+	bool ts_under = (timestamp < line->next_ts_min);
+	uint64_t diff = ts_under ?
+		(line->next_ts_min - timestamp) :
+		(timestamp - line->next_ts_min);
+
+#ifdef DEBUG_AUDIO
+	if (diff >= TS_SMOOTHING_THRESHOLD)
+		blog(LOG_DEBUG, "above TS smoothing threshold by %"PRIu64,
+				diff);
+#endif
+
+	return (diff < TS_SMOOTHING_THRESHOLD) ? line->next_ts_min : timestamp;
+}
+
+static void audio_line_place_data(struct audio_line *line,
+		const struct audio_line_packet *packet)
+{
+	size_t pos;
+	uint64_t timestamp = smooth_ts(line, packet->timestamp);
+
+	pos = ts_diff_bytes(line->audio, timestamp, line->base_timestamp);
+	line->next_ts_min =
+		timestamp + conv_frames_to_time(line->audio, packet->frames);
+
+#ifdef DEBUG_AUDIO
+	blog(LOG_DEBUG, "packet->timestamp: %llu, line->base_timestamp: %llu, "
+			"pos: %lu, bytes: %lu, buf size: %lu",
+			timestamp, line->base_timestamp, pos,
+			packet->frames * line->audio->block_size,
+			line->buffers[0].size);
+#endif
+
+	audio_line_place_data_pos(line, packet, pos);
+}
+
+#define MAX_DELAY_NS 6000000000ULL
+
+/* prevent insertation of data too far away from expected audio timing */
+static inline bool valid_timestamp_range(struct audio_line *line, uint64_t ts)
+{
+	uint64_t buffer_ns = 1000000ULL * line->audio->info.buffer_ms;
+	uint64_t max_ts    = line->base_timestamp + buffer_ns + MAX_DELAY_NS;
+
+	return ts >= line->base_timestamp && ts < max_ts;
+}
+
+static void audio_line_process_packet(struct audio_line *line,
+		const struct audio_line_packet *packet)
+{
+	if (!line->buffers[0].size) {
+		line->base_timestamp = packet->timestamp -
+		                       line->audio->info.buffer_ms * 1000000;
+		audio_line_place_data(line, packet);
+
+	} else if (valid_timestamp_range(line, packet->timestamp)) {
+		audio_line_place_data(line, packet);
+
+	} else {
+		blog(LOG_DEBUG, "Bad timestamp for audio line '%s', "
+		                "packet->timestamp: %"PRIu64", "
+		                "line->base_timestamp: %"PRIu64".  This can "
+		                "sometimes happen when there's a pause in "
+		                "the threads.", line->name, packet->timestamp,
+		                line->base_timestamp);
+	}
+}
+
+/* called from the audio thread to move everything queued on the line into
+ * its buffers */
+static void audio_line_process_queue(struct audio_line *line)
+{
+	long read  = line->queue_read;
+	long write = os_atomic_load_long(&line->queue_write);
+
+	while (read != write) {
+		size_t idx = (unsigned long)read & (AUDIO_LINE_QUEUE_SIZE - 1);
+
+		audio_line_process_packet(line, &line->queue[idx]);
+		os_atomic_set_long(&line->queue_read, ++read);
+	}
+}
+
+/* returns a mask of the mixes that this is the last line to be routed to */
+static inline uint32_t get_clamp_mixes(struct audio_line *line,
+		uint32_t mixes)
+{
+	for (line = line->next; line && mixes; line = line->next)
+		mixes &= ~line->mixers;
+
+	return mixes;
+}
+
 static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 		uint64_t prev_time)
 {
@@ -332,6 +634,7 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 	uint32_t frames = (uint32_t)ts_diff_frames(audio, audio_time,
 	                                           prev_time);
 	size_t bytes = frames * audio->block_size;
+	uint32_t active_mixes = 0;
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "audio_time: %llu, prev_time: %llu, bytes: %lu",
@@ -342,72 +645,116 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 	 * of data that was sampled to ensure seamless transmission */
 	audio_time = prev_time + conv_frames_to_time(audio, frames);
 
-	/* resize and clear mix buffers */
+	/* resize and clear the buffers of mixes that have anything connected,
+	 * the rest are left untouched */
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
+		if (!mix->inputs.num)
+			continue;
+
+		active_mixes |= 1 << mix_idx;
+
 		for (size_t i = 0; i < audio->planes; i++) {
 			da_resize(mix->mix_buffers[i], bytes);
 			memset(mix->mix_buffers[i].array, 0, bytes);
+			mix->clamped_start[i] = 0;
+			mix->clamped_end[i]   = 0;
 		}
 	}
 
 	/* mix audio lines */
 	while (line) {
 		struct audio_line *next = line->next;
+		bool alive = os_atomic_load_long(&line->alive) != 0;
+		uint32_t mixes;
+
+		audio_line_process_queue(line);
 
 		/* if line marked for removal, destroy and move to the next */
 		if (!line->buffers[0].size) {
-			if (!line->alive) {
+			if (!alive) {
 				audio_output_removeline(audio, line);
 				line = next;
 				continue;
 			}
 		}
 
-		pthread_mutex_lock(&line->mutex);
-
 		if (line->buffers[0].size && line->base_timestamp < prev_time) {
 			clear_excess_audio_data(line, prev_time);
 			line->base_timestamp = prev_time;
 		}
 
-		if (mix_audio_line(audio, line, bytes, prev_time))
-			line->base_timestamp = audio_time;
+		mixes = line->mixers & active_mixes;
 
-		pthread_mutex_unlock(&line->mutex);
+		if (mix_audio_line(audio, line, bytes, prev_time, mixes,
+					get_clamp_mixes(line, mixes)))
+			line->base_timestamp = audio_time;
 
 		line = next;
 	}
 
 	/* clamps audio data to -1.0..1.0 */
-	clamp_audio_output(audio, bytes);
+	clamp_audio_output(audio, active_mixes, bytes);
 
 	/* output */
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, prev_time, frames);
+		if (active_mixes & (1 << i))
+			queue_mix_output(audio, &audio->mixes[i], prev_time,
+					frames);
 
 	return audio_time;
 }
 
-/* sample audio 40 times a second */
-#define AUDIO_WAIT_TIME (1000/40)
+/* by default, sample audio 40 times a second */
+#define AUDIO_DEFAULT_PERIOD_MS (1000/40)
+
+/* sleeps until the next tick deadline.  deadlines are absolute so that time
+ * spent mixing does not accumulate into drift; if a tick is missed entirely
+ * the schedule is resynced to the current time rather than bursting.  the
+ * deadline itself is returned so each tick mixes an even amount of audio.
+ *
+ * in offline mode, waits for the clock to be advanced instead of sleeping */
+static uint64_t audio_wait(struct audio_output *audio, uint64_t *next_tick)
+{
+	uint64_t time;
+
+	if (!audio->info.offline) {
+		if (!os_sleepto_ns(*next_tick))
+			*next_tick = os_gettime_ns();
+
+		time = *next_tick;
+		*next_tick += audio->period_ns;
+		return time;
+	}
+
+	os_sem_wait(audio->clock_sem);
+
+	pthread_mutex_lock(&audio->clock_mutex);
+	time = audio->clock_time;
+	pthread_mutex_unlock(&audio->clock_mutex);
+
+	return time;
+}
 
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
 	uint64_t buffer_time = audio->info.buffer_ms * 1000000;
-	uint64_t prev_time = os_gettime_ns() - buffer_time;
+	uint64_t next_tick = os_gettime_ns() + audio->period_ns;
+	uint64_t start_time = audio->info.offline ?
+		audio_wait(audio, &next_tick) : os_gettime_ns();
+	uint64_t prev_time = start_time - buffer_time;
 	uint64_t audio_time;
 
 	os_set_thread_name("audio-io: audio thread");
 
 	while (os_event_try(audio->stop_event) == EAGAIN) {
-		os_sleep_ms(AUDIO_WAIT_TIME);
+		uint64_t cur_time = audio_wait(audio, &next_tick);
 
 		pthread_mutex_lock(&audio->line_mutex);
 
-		audio_time = os_gettime_ns() - buffer_time;
+		audio_time = cur_time - buffer_time;
 		audio_time = mix_and_output(audio, audio_time, prev_time);
 		prev_time  = audio_time;
 
@@ -434,12 +781,24 @@ static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx,
 	return DARRAY_INVALID;
 }
 
-static inline bool audio_input_init(struct audio_input *input,
-		struct audio_output *audio)
+static inline bool convert_info_equal(const struct audio_convert_info *a,
+		const struct audio_convert_info *b)
 {
-	if (input->conversion.format          != audio->info.format          ||
-	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
-	    input->conversion.speakers        != audio->info.speakers) {
+	return a->format          == b->format          &&
+	       a->samples_per_sec == b->samples_per_sec &&
+	       a->speakers        == b->speakers;
+}
+
+static struct audio_conversion *audio_conversion_create(
+		struct audio_output *audio,
+		const struct audio_convert_info *info)
+{
+	struct audio_conversion *convert = bzalloc(sizeof(*convert));
+	convert->info = *info;
+
+	if (info->format          != audio->info.format          ||
+	    info->samples_per_sec != audio->info.samples_per_sec ||
+	    info->speakers        != audio->info.speakers) {
 		struct resample_info from = {
 			.format          = audio->info.format,
 			.samples_per_sec = audio->info.samples_per_sec,
@@ -447,21 +806,84 @@ static inline bool audio_input_init(struct audio_input *input,
 		};
 
 		struct resample_info to = {
-			.format          = input->conversion.format,
-			.samples_per_sec = input->conversion.samples_per_sec,
-			.speakers        = input->conversion.speakers
+			.format          = info->format,
+			.samples_per_sec = info->samples_per_sec,
+			.speakers        = info->speakers
 		};
 
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
+		convert->resampler = audio_resampler_create(&to, &from);
+		if (!convert->resampler) {
 			blog(LOG_ERROR, "audio_input_init: Failed to "
 			                "create resampler");
-			return false;
+			bfree(convert);
+			return NULL;
 		}
-	} else {
-		input->resampler = NULL;
 	}
 
+	return convert;
+}
+
+static struct audio_conversion *audio_conversion_get(
+		struct audio_output *audio, struct audio_mix *mix,
+		const struct audio_convert_info *info)
+{
+	struct audio_conversion *convert;
+
+	for (size_t i = 0; i < mix->conversions.num; i++) {
+		convert = mix->conversions.array[i];
+
+		if (convert_info_equal(&convert->info, info)) {
+			convert->refs++;
+			return convert;
+		}
+	}
+
+	convert = audio_conversion_create(audio, info);
+	if (convert) {
+		convert->refs = 1;
+		da_push_back(mix->conversions, &convert);
+	}
+
+	return convert;
+}
+
+static void audio_conversion_release(struct audio_mix *mix,
+		struct audio_conversion *convert)
+{
+	if (--convert->refs != 0)
+		return;
+
+	da_erase_item(mix->conversions, &convert);
+	audio_resampler_destroy(convert->resampler);
+	bfree(convert);
+}
+
+static inline bool audio_input_init(struct audio_input *input,
+		struct audio_output *audio, struct audio_mix *mix)
+{
+	input->convert = audio_conversion_get(audio, mix, &input->conversion);
+	return input->convert != NULL;
+}
+
+static inline void audio_input_free(struct audio_mix *mix,
+		struct audio_input *input)
+{
+	audio_conversion_release(mix, input->convert);
+}
+
+/* called with the mix's input mutex held */
+static bool audio_mix_start_thread(struct audio_mix *mix)
+{
+	if (mix->thread_initialized)
+		return true;
+
+	if (pthread_create(&mix->thread, NULL, audio_mix_thread, mix) != 0) {
+		blog(LOG_ERROR, "audio_output_connect: Failed to create "
+		                "output thread for mix %d", (int)mix->idx);
+		return false;
+	}
+
+	mix->thread_initialized = true;
 	return true;
 }
 
@@ -473,7 +895,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 
 	if (!audio || mi >= MAX_AUDIO_MIXES) return false;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	pthread_mutex_lock(&audio->mixes[mi].input_mutex);
 
 	if (audio_get_input_idx(audio, mi, callback, param) == DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mi];
@@ -498,12 +920,13 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 			input.conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
+		success = audio_mix_start_thread(mix) &&
+			audio_input_init(&input, audio, mix);
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	pthread_mutex_unlock(&audio->mixes[mi].input_mutex);
 
 	return success;
 }
@@ -513,16 +936,29 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 {
 	if (!audio || mix_idx >= MAX_AUDIO_MIXES) return;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	struct audio_mix *mix = &audio->mixes[mix_idx];
+
+	pthread_mutex_lock(&mix->input_mutex);
 
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
-		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array+idx);
+		audio_input_free(mix, mix->inputs.array+idx);
 		da_erase(mix->inputs, idx);
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	pthread_mutex_unlock(&mix->input_mutex);
+}
+
+static bool audio_mix_init(struct audio_mix *mix, pthread_mutexattr_t *attr)
+{
+	if (pthread_mutex_init(&mix->input_mutex, attr) != 0)
+		return false;
+	if (pthread_mutex_init(&mix->output_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&mix->output_sem, 0) != 0)
+		return false;
+
+	return true;
 }
 
 static inline bool valid_audio_params(const struct audio_output_info *info)
@@ -545,11 +981,24 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
+	if (!out->info.period_ms)
+		out->info.period_ms = AUDIO_DEFAULT_PERIOD_MS;
+	out->period_ns = (uint64_t)out->info.period_ms * 1000000ULL;
 	pthread_mutex_init_value(&out->line_mutex);
+	pthread_mutex_init_value(&out->clock_mutex);
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		struct audio_mix *mix = &out->mixes[i];
+
+		mix->audio = out;
+		mix->idx   = i;
+		pthread_mutex_init_value(&mix->input_mutex);
+		pthread_mutex_init_value(&mix->output_mutex);
+	}
 	out->channels   = get_audio_channels(info->speakers);
 	out->planes     = planar ? out->channels : 1;
 	out->block_size = (planar ? 1 : out->channels) *
 	                  get_audio_bytes_per_channel(info->format);
+	audio_mix_get_funcs(&out->mix_funcs);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		goto fail;
@@ -557,10 +1006,15 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->line_mutex, &attr) != 0)
 		goto fail;
-	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
-		goto fail;
 	if (os_event_init(&out->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&out->clock_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&out->clock_sem, 0) != 0)
+		goto fail;
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+		if (!audio_mix_init(&out->mixes[i], &attr))
+			goto fail;
 	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
 		goto fail;
 
@@ -583,9 +1037,20 @@ void audio_output_close(audio_t *audio)
 
 	if (audio->initialized) {
 		os_event_signal(audio->stop_event);
+		os_sem_post(audio->clock_sem);
 		pthread_join(audio->thread, &thread_ret);
 	}
 
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		struct audio_mix *mix = &audio->mixes[mix_idx];
+
+		if (mix->thread_initialized) {
+			os_event_signal(audio->stop_event);
+			os_sem_post(mix->output_sem);
+			pthread_join(mix->thread, &thread_ret);
+		}
+	}
+
 	line = audio->first_line;
 	while (line) {
 		struct audio_line *next = line->next;
@@ -597,15 +1062,24 @@ void audio_output_close(audio_t *audio)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
-			audio_input_free(mix->inputs.array+i);
+			audio_input_free(mix, mix->inputs.array+i);
 
-		for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
 			da_free(mix->mix_buffers[i]);
+			da_free(mix->output_buffers[i]);
+		}
 
 		da_free(mix->inputs);
+		da_free(mix->conversions);
+		circlebuf_free(&mix->output_queue);
+		os_sem_destroy(mix->output_sem);
+		pthread_mutex_destroy(&mix->output_mutex);
+		pthread_mutex_destroy(&mix->input_mutex);
 	}
 
 	os_event_destroy(audio->stop_event);
+	os_sem_destroy(audio->clock_sem);
+	pthread_mutex_destroy(&audio->clock_mutex);
 	pthread_mutex_destroy(&audio->line_mutex);
 	bfree(audio);
 }
@@ -616,17 +1090,10 @@ audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 	if (!audio) return NULL;
 
 	struct audio_line *line = bzalloc(sizeof(struct audio_line));
-	line->alive = true;
+	line->alive = 1;
 	line->audio = audio;
 	line->mixers = mixers;
 
-	if (pthread_mutex_init(&line->mutex, NULL) != 0) {
-		blog(LOG_ERROR, "audio_output_createline: Failed to create "
-		                "mutex");
-		bfree(line);
-		return NULL;
-	}
-
 	pthread_mutex_lock(&audio->line_mutex);
 
 	if (audio->first_line) {
@@ -648,14 +1115,24 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_set_time(audio_t *audio, uint64_t timestamp)
+{
+	if (!audio || !audio->info.offline)
+		return;
+
+	pthread_mutex_lock(&audio->clock_mutex);
+	audio->clock_time = timestamp;
+	pthread_mutex_unlock(&audio->clock_mutex);
+
+	os_sem_post(audio->clock_sem);
+}
+
+/* the line is removed by the audio thread once it has mixed everything that
+ * was queued on it */
 void audio_line_destroy(struct audio_line *line)
 {
-	if (line) {
-		if (!line->buffers[0].size)
-			audio_output_removeline(line->audio, line);
-		else
-			line->alive = false;
-	}
+	if (line)
+		os_atomic_set_long(&line->alive, 0);
 }
 
 bool audio_output_active(const audio_t *audio)
@@ -692,25 +1169,26 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 	return audio ? audio->info.samples_per_sec : 0;
 }
 
-/* TODO: optimize these two functions */
 static inline void mul_vol_float(float *array, float volume, size_t count)
 {
 	for (size_t i = 0; i < count; i++)
 		array[i] *= volume;
 }
 
-static void audio_line_place_data_pos(struct audio_line *line,
-		const struct audio_data *data, size_t position)
+static void audio_line_fill_packet(struct audio_line *line,
+		struct audio_line_packet *packet, const struct audio_data *data)
 {
 	bool   planar     = line->audio->planes > 1;
 	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
 	size_t total_size = data->frames * line->audio->block_size;
 
+	packet->frames    = data->frames;
+	packet->timestamp = data->timestamp;
+
 	for (size_t i = 0; i < line->audio->planes; i++) {
-		da_copy_array(line->volume_buffers[i], data->data[i],
-				total_size);
+		da_copy_array(packet->data[i], data->data[i], total_size);
 
-		uint8_t *array = line->volume_buffers[i].array;
+		uint8_t *array = packet->data[i].array;
 
 		switch (line->audio->info.format) {
 		case AUDIO_FORMAT_FLOAT:
@@ -718,91 +1196,39 @@ static void audio_line_place_data_pos(struct audio_line *line,
 			mul_vol_float((float*)array, data->volume, total_num);
 			break;
 		default:
-			blog(LOG_ERROR, "audio_line_place_data_pos: "
+			blog(LOG_ERROR, "audio_line_fill_packet: "
 			                "Unsupported or unknown format");
 			break;
 		}
-
-		circlebuf_place(&line->buffers[i], position,
-				line->volume_buffers[i].array, total_size);
 	}
 }
 
-static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
-{
-	if (!line->next_ts_min)
-		return timestamp;
-
-	bool ts_under = (timestamp < line->next_ts_min);
-	uint64_t diff = ts_under ?
-		(line->next_ts_min - timestamp) :
-		(timestamp - line->next_ts_min);
-
-#ifdef DEBUG_AUDIO
-	if (diff >= TS_SMOOTHING_THRESHOLD)
-		blog(LOG_DEBUG, "above TS smoothing threshold by %"PRIu64,
-				diff);
-#endif
-
-	return (diff < TS_SMOOTHING_THRESHOLD) ? line->next_ts_min : timestamp;
-}
-
-static void audio_line_place_data(struct audio_line *line,
-		const struct audio_data *data)
-{
-	size_t pos;
-	uint64_t timestamp = smooth_ts(line, data->timestamp);
-
-	pos = ts_diff_bytes(line->audio, timestamp, line->base_timestamp);
-	line->next_ts_min =
-		timestamp + conv_frames_to_time(line->audio, data->frames);
-
-#ifdef DEBUG_AUDIO
-	blog(LOG_DEBUG, "data->timestamp: %llu, line->base_timestamp: %llu, "
-			"pos: %lu, bytes: %lu, buf size: %lu",
-			timestamp, line->base_timestamp, pos,
-			data->frames * line->audio->block_size,
-			line->buffers[0].size);
-#endif
-
-	audio_line_place_data_pos(line, data, pos);
-}
-
-#define MAX_DELAY_NS 6000000000ULL
-
-/* prevent insertation of data too far away from expected audio timing */
-static inline bool valid_timestamp_range(struct audio_line *line, uint64_t ts)
-{
-	uint64_t buffer_ns = 1000000ULL * line->audio->info.buffer_ms;
-	uint64_t max_ts    = line->base_timestamp + buffer_ns + MAX_DELAY_NS;
-
-	return ts >= line->base_timestamp && ts < max_ts;
-}
-
 void audio_line_output(audio_line_t *line, const struct audio_data *data)
 {
+	struct audio_line_packet *packet;
+	long write, read;
+
 	if (!line || !data) return;
 
-	pthread_mutex_lock(&line->mutex);
+	write = line->queue_write;
+	read  = os_atomic_load_long(&line->queue_read);
 
-	if (!line->buffers[0].size) {
-		line->base_timestamp = data->timestamp -
-		                       line->audio->info.buffer_ms * 1000000;
-		audio_line_place_data(line, data);
+	if ((unsigned long)(write - read) >= AUDIO_LINE_QUEUE_SIZE) {
+		if (!line->queue_overflow)
+			blog(LOG_WARNING, "Audio line '%s' queue is full, "
+			                  "dropping audio until the audio "
+			                  "thread catches up", line->name);
+		line->queue_overflow = true;
+		return;
+	}
 
-	} else if (valid_timestamp_range(line, data->timestamp)) {
-		audio_line_place_data(line, data);
+	line->queue_overflow = false;
 
-	} else {
-		blog(LOG_DEBUG, "Bad timestamp for audio line '%s', "
-		                "data->timestamp: %"PRIu64", "
-		                "line->base_timestamp: %"PRIu64".  This can "
-		                "sometimes happen when there's a pause in "
-		                "the threads.", line->name, data->timestamp,
-		                line->base_timestamp);
-	}
+	packet = &line->queue[(unsigned long)write &
+		(AUDIO_LINE_QUEUE_SIZE - 1)];
+	audio_line_fill_packet(line, packet, data);
 
-	pthread_mutex_unlock(&line->mutex);
+	os_atomic_set_long(&line->queue_write, write + 1);
 }
 
 void audio_line_set_mixers(audio_line_t *line, uint32_t mixers)
@@ -78,6 +78,13 @@ struct audio_output_info {
 	enum audio_format   format;
 	enum speaker_layout speakers;
 	uint64_t            buffer_ms;
+
+	/* how often mixed audio is output, in milliseconds (0 = default) */
+	uint32_t            period_ms;
+
+	/* mix up to the time given by audio_output_set_time instead of
+	 * following the system clock */
+	bool                offline;
 };
 
 struct audio_convert_info {
@@ -192,6 +199,9 @@ EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *audio_output_get_info(
 		const audio_t *audio);
 
+/** Advances the clock of an offline audio output (ignored otherwise) */
+EXPORT void audio_output_set_time(audio_t *audio, uint64_t timestamp);
+
 EXPORT audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 		uint32_t mixers);
 EXPORT void audio_line_set_mixers(audio_line_t *line, uint32_t mixers);
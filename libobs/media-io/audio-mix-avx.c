@@ -0,0 +1,77 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-mix-internal.h"
+#include <immintrin.h>
+
+/* AVX versions of the mixing kernels, 8 samples per iteration.  This file
+ * must be compiled with AVX code generation enabled, and is only ever called
+ * when the CPU supports it. */
+
+static FORCE_INLINE float clamp_sample(float val)
+{
+	val = (val >  1.0f) ?  1.0f : val;
+	val = (val < -1.0f) ? -1.0f : val;
+	return val;
+}
+
+void audio_mix_add_avx(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_loadu_ps(dst + i),
+				_mm256_loadu_ps(src + i));
+		_mm256_storeu_ps(dst + i, sum);
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+void audio_mix_add_clamp_avx(float *dst, const float *src, size_t count)
+{
+	const __m256 max_val = _mm256_set1_ps(1.0f);
+	const __m256 min_val = _mm256_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_loadu_ps(dst + i),
+				_mm256_loadu_ps(src + i));
+		sum = _mm256_max_ps(_mm256_min_ps(sum, max_val), min_val);
+		_mm256_storeu_ps(dst + i, sum);
+	}
+
+	for (; i < count; i++)
+		dst[i] = clamp_sample(dst[i] + src[i]);
+}
+
+void audio_mix_clamp_avx(float *data, size_t count)
+{
+	const __m256 max_val = _mm256_set1_ps(1.0f);
+	const __m256 min_val = _mm256_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 val = _mm256_loadu_ps(data + i);
+		val = _mm256_max_ps(_mm256_min_ps(val, max_val), min_val);
+		_mm256_storeu_ps(data + i, val);
+	}
+
+	for (; i < count; i++)
+		data[i] = clamp_sample(data[i]);
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * Float mixing kernels used by the audio output.  audio_mix_get_funcs picks
+ * the best variant for the CPU; the audio output resolves them once when it
+ * is opened.
+ */
+
+typedef void (*audio_mix_add_func_t)(float *dst, const float *src,
+		size_t count);
+typedef void (*audio_mix_clamp_func_t)(float *data, size_t count);
+
+struct audio_mix_funcs {
+	/** Adds count samples of src to dst */
+	audio_mix_add_func_t   add;
+
+	/** Adds count samples of src to dst, clamping the result to -1..1 */
+	audio_mix_add_func_t   add_clamp;
+
+	/** Clamps count samples to -1.0..1.0 */
+	audio_mix_clamp_func_t clamp;
+};
+
+extern void audio_mix_get_funcs(struct audio_mix_funcs *funcs);
+
+extern void audio_mix_add_avx(float *dst, const float *src, size_t count);
+extern void audio_mix_add_clamp_avx(float *dst, const float *src,
+		size_t count);
+extern void audio_mix_clamp_avx(float *data, size_t count);
@@ -0,0 +1,93 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "../util/platform.h"
+#include "audio-mix-internal.h"
+#include <xmmintrin.h>
+
+static FORCE_INLINE float clamp_sample(float val)
+{
+	val = (val >  1.0f) ?  1.0f : val;
+	val = (val < -1.0f) ? -1.0f : val;
+	return val;
+}
+
+/* ------------------------------------------------------------------------- */
+/* SSE, 4 samples per iteration */
+
+static void audio_mix_add_sse(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_add_ps(_mm_loadu_ps(dst + i),
+				_mm_loadu_ps(src + i));
+		_mm_storeu_ps(dst + i, sum);
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+static void audio_mix_add_clamp_sse(float *dst, const float *src,
+		size_t count)
+{
+	const __m128 max_val = _mm_set1_ps(1.0f);
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_add_ps(_mm_loadu_ps(dst + i),
+				_mm_loadu_ps(src + i));
+		sum = _mm_max_ps(_mm_min_ps(sum, max_val), min_val);
+		_mm_storeu_ps(dst + i, sum);
+	}
+
+	for (; i < count; i++)
+		dst[i] = clamp_sample(dst[i] + src[i]);
+}
+
+static void audio_mix_clamp_sse(float *data, size_t count)
+{
+	const __m128 max_val = _mm_set1_ps(1.0f);
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 val = _mm_loadu_ps(data + i);
+		val = _mm_max_ps(_mm_min_ps(val, max_val), min_val);
+		_mm_storeu_ps(data + i, val);
+	}
+
+	for (; i < count; i++)
+		data[i] = clamp_sample(data[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void audio_mix_get_funcs(struct audio_mix_funcs *funcs)
+{
+	if (os_get_cpu_features() & OS_CPU_AVX) {
+		funcs->add       = audio_mix_add_avx;
+		funcs->add_clamp = audio_mix_add_clamp_avx;
+		funcs->clamp     = audio_mix_clamp_avx;
+	} else {
+		funcs->add       = audio_mix_add_sse;
+		funcs->add_clamp = audio_mix_add_clamp_sse;
+		funcs->clamp     = audio_mix_clamp_sse;
+	}
+}
@@ -15,14 +15,20 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <math.h>
 #include "../util/bmem.h"
 #include "audio-resampler.h"
+#include "audio-resampler-native.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
 struct audio_resampler {
+	/* in-tree resampler, used instead of swr when it can handle the
+	 * conversion */
+	struct native_resampler *native;
+
 	struct SwrContext   *context;
 	bool                opened;
 
@@ -83,6 +89,10 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
 	int errcode;
 
+	rs->native = native_resampler_create(dst, src);
+	if (rs->native)
+		return rs;
+
 	rs->opened        = false;
 	rs->input_freq    = src->samples_per_sec;
 	rs->input_layout  = convert_speaker_layout(src->speakers);
@@ -119,6 +129,7 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
+		native_resampler_destroy(rs->native);
 		if (rs->context)
 			swr_free(&rs->context);
 		if (rs->output_buffer[0])
@@ -134,6 +145,10 @@ bool audio_resampler_resample(audio_resampler_t *rs,
 {
 	if (!rs) return false;
 
+	if (rs->native)
+		return native_resampler_resample(rs->native, output,
+				out_frames, ts_offset, input, in_frames);
+
 	struct SwrContext *context = rs->context;
 	int ret;
 
@@ -171,3 +186,22 @@ bool audio_resampler_resample(audio_resampler_t *rs,
 	*out_frames = (uint32_t)ret;
 	return true;
 }
+
+/* swr only compensates over a fixed distance, so it's set far enough ahead
+ * that it will always be refreshed before it runs out */
+#define COMPENSATION_SECONDS 60
+
+bool audio_resampler_set_compensation(audio_resampler_t *rs, double ratio)
+{
+	int distance, delta;
+
+	if (!rs) return false;
+
+	if (rs->native)
+		return native_resampler_set_compensation(rs->native, ratio);
+
+	distance = (int)rs->output_freq * COMPENSATION_SECONDS;
+	delta    = (int)lrint((ratio - 1.0) * (double)distance);
+
+	return swr_set_compensation(rs->context, delta, distance) >= 0;
+}
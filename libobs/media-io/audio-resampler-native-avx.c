@@ -0,0 +1,71 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-resampler-native.h"
+#include <immintrin.h>
+
+/* AVX version of the polyphase filter, 8 taps per iteration.  This file must
+ * be compiled with AVX code generation enabled, and is only ever called when
+ * the CPU supports it. */
+
+static FORCE_INLINE float dot_avx(const float *src, const float *coeffs,
+		uint32_t taps)
+{
+	__m256 sum = _mm256_setzero_ps();
+	__m128 low, high;
+
+	for (uint32_t i = 0; i < taps; i += 8) {
+		__m256 prod = _mm256_mul_ps(_mm256_loadu_ps(src + i),
+				_mm256_loadu_ps(coeffs + i));
+		sum = _mm256_add_ps(sum, prod);
+	}
+
+	low  = _mm256_castps256_ps128(sum);
+	high = _mm256_extractf128_ps(sum, 1);
+	low  = _mm_add_ps(low, high);
+	low  = _mm_add_ps(low, _mm_movehl_ps(low, low));
+	low  = _mm_add_ss(low, _mm_shuffle_ps(low, low, 0x55));
+	return _mm_cvtss_f32(low);
+}
+
+size_t resample_filter_run_avx(const struct resample_filter *filter,
+		float *dst, size_t max_out, const float *src, size_t src_len,
+		struct resample_pos *pos)
+{
+	struct resample_pos cur = *pos;
+	size_t count = 0;
+
+	while (count < max_out && cur.pos + filter->taps <= src_len) {
+		const float *coeffs = filter->coeffs + cur.frac * filter->taps;
+		uint32_t sub = cur.sub;
+
+		dst[count++] = dot_avx(src + cur.pos, coeffs, filter->taps);
+
+		cur.sub  += filter->sub_step;
+		cur.pos  += filter->int_step;
+		cur.frac += filter->frac_step + (cur.sub < sub ? 1 : 0);
+		if (cur.frac >= filter->phases) {
+			cur.frac -= filter->phases;
+			cur.pos++;
+		}
+	}
+
+	_mm256_zeroupper();
+
+	*pos = cur;
+	return count;
+}
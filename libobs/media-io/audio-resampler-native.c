@@ -0,0 +1,605 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <xmmintrin.h>
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+#include "audio-resampler-native.h"
+
+/* windowed sinc parameters, roughly equivalent to the libswresample
+ * defaults */
+#define NATIVE_TAPS       32
+#define NATIVE_MAX_PHASES 1024
+
+/* with a fixed number of taps the filter gets too short to keep its stop band
+ * when the cutoff is lowered any further than this, swr is used instead */
+#define NATIVE_MAX_DOWNSAMPLE 4
+
+/* phases are multiplied up to at least this many so that the ratio can be
+ * fine tuned for drift compensation */
+#define NATIVE_MIN_PHASES 256
+#define NATIVE_CUTOFF     0.97
+#define NATIVE_BETA       9.0
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#ifndef M_SQRT1_2
+#define M_SQRT1_2 0.70710678118654752440
+#endif
+
+enum channel_map {
+	CHANNEL_MAP_COPY,
+	CHANNEL_MAP_DOWNMIX, /* stereo -> mono, before filtering */
+	CHANNEL_MAP_UPMIX,   /* mono -> stereo, after filtering */
+};
+
+struct native_resampler {
+	struct resample_info   src;
+	struct resample_info   dst;
+	uint32_t               src_channels;
+	uint32_t               dst_channels;
+	uint32_t               channels;       /* channels actually filtered */
+	uint32_t               output_planes;
+	enum channel_map       map;
+
+	/* if the rates are equal (and there's no compensation) only the
+	 * format/channels are converted */
+	bool                   passthrough;
+	struct resample_filter filter;
+	struct resample_pos    pos;
+	uint32_t               step;           /* nominal phases per output */
+
+	DARRAY(float)          buffers[MAX_AV_PLANES];
+	DARRAY(float)          filtered[MAX_AV_PLANES];
+	DARRAY(float)          downmix;
+	DARRAY(uint8_t)        output[MAX_AV_PLANES];
+};
+
+/* ------------------------------------------------------------------------- */
+/* filter kernels */
+
+typedef size_t (*filter_run_func_t)(const struct resample_filter *filter,
+		float *dst, size_t max_out, const float *src, size_t src_len,
+		struct resample_pos *pos);
+
+static FORCE_INLINE float dot_sse(const float *src, const float *coeffs,
+		uint32_t taps)
+{
+	__m128 sum1 = _mm_setzero_ps();
+	__m128 sum2 = _mm_setzero_ps();
+
+	for (uint32_t i = 0; i < taps; i += 8) {
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(src + i),
+					_mm_loadu_ps(coeffs + i)));
+		sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(src + i + 4),
+					_mm_loadu_ps(coeffs + i + 4)));
+	}
+
+	sum1 = _mm_add_ps(sum1, sum2);
+	sum1 = _mm_add_ps(sum1, _mm_movehl_ps(sum1, sum1));
+	sum1 = _mm_add_ss(sum1, _mm_shuffle_ps(sum1, sum1, 0x55));
+	return _mm_cvtss_f32(sum1);
+}
+
+static size_t resample_filter_run_sse(const struct resample_filter *filter,
+		float *dst, size_t max_out, const float *src, size_t src_len,
+		struct resample_pos *pos)
+{
+	struct resample_pos cur = *pos;
+	size_t count = 0;
+
+	while (count < max_out && cur.pos + filter->taps <= src_len) {
+		const float *coeffs = filter->coeffs + cur.frac * filter->taps;
+		uint32_t sub = cur.sub;
+
+		dst[count++] = dot_sse(src + cur.pos, coeffs, filter->taps);
+
+		cur.sub  += filter->sub_step;
+		cur.pos  += filter->int_step;
+		cur.frac += filter->frac_step + (cur.sub < sub ? 1 : 0);
+		if (cur.frac >= filter->phases) {
+			cur.frac -= filter->phases;
+			cur.pos++;
+		}
+	}
+
+	*pos = cur;
+	return count;
+}
+
+static pthread_once_t    filter_init_token = PTHREAD_ONCE_INIT;
+static filter_run_func_t filter_run_func;
+
+static void init_filter_funcs(void)
+{
+	if (os_get_cpu_features() & OS_CPU_AVX)
+		filter_run_func = resample_filter_run_avx;
+	else
+		filter_run_func = resample_filter_run_sse;
+}
+
+/* ------------------------------------------------------------------------- */
+/* filter design */
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* zeroth order modified bessel function of the first kind */
+static double bessel_i0(double x)
+{
+	double sum  = 1.0;
+	double term = 1.0;
+
+	for (int i = 1; i < 50; i++) {
+		term *= (x * 0.5 / i) * (x * 0.5 / i);
+		sum  += term;
+
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+static void build_filter(struct resample_filter *filter, uint32_t phases,
+		uint32_t step)
+{
+	uint32_t taps   = NATIVE_TAPS;
+	double   half   = taps / 2;
+	double   cutoff = NATIVE_CUTOFF;
+	double   i0beta = bessel_i0(NATIVE_BETA);
+
+	/* when downsampling, the cutoff has to be below the new nyquist */
+	if (step > phases)
+		cutoff *= (double)phases / (double)step;
+
+	filter->taps      = taps;
+	filter->phases    = phases;
+	filter->coeffs    = bmalloc(sizeof(float) * taps * phases);
+
+	for (uint32_t p = 0; p < phases; p++) {
+		float *coeffs = filter->coeffs + p * taps;
+		double sum = 0.0;
+
+		for (uint32_t k = 0; k < taps; k++) {
+			double x = (double)k - (half - 1.0) -
+				(double)p / (double)phases;
+			double w = x / half;
+			double val;
+
+			val = (x == 0.0) ? 1.0 :
+				sin(M_PI * x * cutoff) / (M_PI * x * cutoff);
+
+			w = (w * w < 1.0) ?
+				bessel_i0(NATIVE_BETA * sqrt(1.0 - w * w)) /
+				i0beta : 0.0;
+
+			coeffs[k] = (float)(val * w);
+			sum += val * w;
+		}
+
+		/* unity gain at DC for every phase */
+		for (uint32_t k = 0; k < taps; k++)
+			coeffs[k] = (float)(coeffs[k] / sum);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* sample format conversion */
+
+static void convert_to_float(float *dst, const uint8_t *src, size_t stride,
+		size_t count, enum audio_format format)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		for (size_t i = 0; i < count; i++)
+			dst[i] = ((float)src[i * stride] - 128.0f) *
+				(1.0f / 128.0f);
+		break;
+
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR: {
+		const int16_t *s16 = (const int16_t*)src;
+		for (size_t i = 0; i < count; i++)
+			dst[i] = (float)s16[i * stride] * (1.0f / 32768.0f);
+		break;
+	}
+
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR: {
+		const int32_t *s32 = (const int32_t*)src;
+		for (size_t i = 0; i < count; i++)
+			dst[i] = (float)((double)s32[i * stride] *
+				(1.0 / 2147483648.0));
+		break;
+	}
+
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR: {
+		const float *f32 = (const float*)src;
+		if (stride == 1) {
+			memcpy(dst, f32, count * sizeof(float));
+		} else {
+			for (size_t i = 0; i < count; i++)
+				dst[i] = f32[i * stride];
+		}
+		break;
+	}
+
+	case AUDIO_FORMAT_UNKNOWN:
+		break;
+	}
+}
+
+static inline float clamp_float(float val)
+{
+	return (val > 1.0f) ? 1.0f : ((val < -1.0f) ? -1.0f : val);
+}
+
+static void convert_from_float(uint8_t *dst, size_t stride, const float *src,
+		size_t count, enum audio_format format)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		for (size_t i = 0; i < count; i++)
+			dst[i * stride] = (uint8_t)lrintf(
+					clamp_float(src[i]) * 127.0f + 128.0f);
+		break;
+
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR: {
+		int16_t *s16 = (int16_t*)dst;
+		for (size_t i = 0; i < count; i++)
+			s16[i * stride] = (int16_t)lrintf(
+					clamp_float(src[i]) * 32767.0f);
+		break;
+	}
+
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR: {
+		int32_t *s32 = (int32_t*)dst;
+		for (size_t i = 0; i < count; i++)
+			s32[i * stride] = (int32_t)lrint(
+					(double)clamp_float(src[i]) *
+					2147483647.0);
+		break;
+	}
+
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR: {
+		float *f32 = (float*)dst;
+		if (stride == 1) {
+			memcpy(f32, src, count * sizeof(float));
+		} else {
+			for (size_t i = 0; i < count; i++)
+				f32[i * stride] = src[i];
+		}
+		break;
+	}
+
+	case AUDIO_FORMAT_UNKNOWN:
+		break;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool get_channel_map(enum channel_map *map,
+		enum speaker_layout dst, enum speaker_layout src)
+{
+	if (dst == SPEAKERS_UNKNOWN || src == SPEAKERS_UNKNOWN)
+		return false;
+
+	if (dst == src)
+		*map = CHANNEL_MAP_COPY;
+	else if (dst == SPEAKERS_MONO && src == SPEAKERS_STEREO)
+		*map = CHANNEL_MAP_DOWNMIX;
+	else if (dst == SPEAKERS_STEREO && src == SPEAKERS_MONO)
+		*map = CHANNEL_MAP_UPMIX;
+	else
+		return false;
+
+	return true;
+}
+
+/* sets the step between output samples, in phases */
+static void set_filter_step(struct native_resampler *rs, double step)
+{
+	struct resample_filter *filter = &rs->filter;
+	double int_step = floor(step / (double)filter->phases);
+	double rem = step - int_step * (double)filter->phases;
+	double frac_step = floor(rem);
+	double sub_step = floor((rem - frac_step) * 4294967296.0);
+
+	filter->int_step  = (uint32_t)int_step;
+	filter->frac_step = (uint32_t)frac_step;
+	filter->sub_step  = sub_step >= 4294967295.0 ?
+		0xFFFFFFFF : (uint32_t)sub_step;
+}
+
+static void init_filter(struct native_resampler *rs, uint32_t phases,
+		uint32_t step)
+{
+	uint32_t mul = (NATIVE_MIN_PHASES + phases - 1) / phases;
+
+	if (phases * mul > NATIVE_MAX_PHASES)
+		mul = 1;
+
+	rs->step = step * mul;
+	build_filter(&rs->filter, phases * mul, rs->step);
+	set_filter_step(rs, (double)rs->step);
+
+	/* prime the history so that the first output sample is centered on
+	 * the first input sample.  the sub-phase starts half way so phases
+	 * are rounded to the nearest rather than truncated */
+	for (uint32_t i = 0; i < rs->channels; i++) {
+		da_resize(rs->buffers[i], rs->filter.taps / 2 - 1);
+		memset(rs->buffers[i].array, 0,
+				rs->buffers[i].num * sizeof(float));
+	}
+
+	rs->pos.pos  = 0;
+	rs->pos.frac = 0;
+	rs->pos.sub  = 0x80000000;
+}
+
+struct native_resampler *native_resampler_create(
+		const struct resample_info *dst,
+		const struct resample_info *src)
+{
+	struct native_resampler *rs;
+	enum channel_map map;
+	uint32_t divisor;
+
+	if (!dst->samples_per_sec || !src->samples_per_sec)
+		return NULL;
+	if (dst->format == AUDIO_FORMAT_UNKNOWN ||
+	    src->format == AUDIO_FORMAT_UNKNOWN)
+		return NULL;
+	if (!get_channel_map(&map, dst->speakers, src->speakers))
+		return NULL;
+
+	divisor = gcd(dst->samples_per_sec, src->samples_per_sec);
+	if (dst->samples_per_sec / divisor > NATIVE_MAX_PHASES)
+		return NULL;
+	if (src->samples_per_sec >
+	    (uint64_t)dst->samples_per_sec * NATIVE_MAX_DOWNSAMPLE)
+		return NULL;
+
+	pthread_once(&filter_init_token, init_filter_funcs);
+
+	rs = bzalloc(sizeof(struct native_resampler));
+	rs->src           = *src;
+	rs->dst           = *dst;
+	rs->map           = map;
+	rs->src_channels  = get_audio_channels(src->speakers);
+	rs->dst_channels  = get_audio_channels(dst->speakers);
+	rs->channels      = map == CHANNEL_MAP_UPMIX ?
+		rs->src_channels : rs->dst_channels;
+	rs->output_planes = is_audio_planar(dst->format) ?
+		rs->dst_channels : 1;
+	rs->passthrough   = dst->samples_per_sec == src->samples_per_sec;
+
+	if (!rs->passthrough)
+		init_filter(rs, dst->samples_per_sec / divisor,
+				src->samples_per_sec / divisor);
+
+	return rs;
+}
+
+void native_resampler_destroy(struct native_resampler *rs)
+{
+	if (!rs)
+		return;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		da_free(rs->buffers[i]);
+		da_free(rs->filtered[i]);
+		da_free(rs->output[i]);
+	}
+
+	da_free(rs->downmix);
+	bfree(rs->filter.coeffs);
+	bfree(rs);
+}
+
+/* grows the channel's input buffer by the given number of samples and
+ * returns the end of it */
+static inline float *get_input_buffer(struct native_resampler *rs,
+		uint32_t ch, size_t frames)
+{
+	if (rs->passthrough) {
+		da_resize(rs->filtered[ch], rs->filtered[ch].num + frames);
+		return rs->filtered[ch].array + rs->filtered[ch].num;
+	} else {
+		da_resize(rs->buffers[ch], rs->buffers[ch].num + frames);
+		return rs->buffers[ch].array + rs->buffers[ch].num;
+	}
+}
+
+/* converts the input to float planar in the layout being filtered, and
+ * appends it to the filter history (or straight to the filtered output if
+ * the rates match) */
+static void append_input(struct native_resampler *rs,
+		const uint8_t *const input[], uint32_t frames)
+{
+	bool   planar = is_audio_planar(rs->src.format);
+	size_t bytes  = get_audio_bytes_per_channel(rs->src.format);
+	size_t stride = planar ? 1 : rs->src_channels;
+
+	for (uint32_t ch = 0; ch < rs->src_channels; ch++) {
+		const uint8_t *src = planar ?
+			input[ch] : input[0] + ch * bytes;
+		float *dst;
+
+		if (rs->map == CHANNEL_MAP_DOWNMIX && ch > 0) {
+			da_resize(rs->downmix, frames);
+			convert_to_float(rs->downmix.array, src, stride,
+					frames, rs->src.format);
+
+			/* same gain as swr's default matrix for float
+			 * output: each side at -3dB */
+			dst = get_input_buffer(rs, 0, 0) - frames;
+			for (uint32_t i = 0; i < frames; i++)
+				dst[i] = (dst[i] + rs->downmix.array[i]) *
+					(float)M_SQRT1_2;
+			continue;
+		}
+
+		dst = get_input_buffer(rs, ch, frames) - frames;
+		convert_to_float(dst, src, stride, frames, rs->src.format);
+	}
+}
+
+static size_t filter_input(struct native_resampler *rs)
+{
+	const struct resample_filter *filter = &rs->filter;
+	size_t len = rs->buffers[0].num;
+	size_t step = (size_t)filter->int_step * filter->phases +
+		filter->frac_step;
+	size_t max_out = 0;
+	size_t count = 0;
+	struct resample_pos pos = rs->pos;
+
+	if (!step)
+		step = 1;
+
+	if (len >= rs->pos.pos + filter->taps)
+		max_out = ((len - filter->taps - rs->pos.pos + 1) *
+			filter->phases + step - 1) / step + 1;
+
+	for (uint32_t ch = 0; ch < rs->channels; ch++) {
+		pos = rs->pos;
+
+		da_resize(rs->filtered[ch], max_out);
+		count = filter_run_func(filter, rs->filtered[ch].array,
+				max_out, rs->buffers[ch].array, len, &pos);
+		rs->filtered[ch].num = count;
+	}
+
+	/* drop the history that no longer affects the output */
+	for (uint32_t ch = 0; ch < rs->channels; ch++)
+		da_erase_range(rs->buffers[ch], 0, pos.pos);
+
+	rs->pos = pos;
+	rs->pos.pos = 0;
+	return count;
+}
+
+static void write_output(struct native_resampler *rs, size_t frames)
+{
+	bool   planar = is_audio_planar(rs->dst.format);
+	size_t bytes  = get_audio_bytes_per_channel(rs->dst.format);
+	size_t stride = planar ? 1 : rs->dst_channels;
+
+	for (uint32_t i = 0; i < rs->output_planes; i++)
+		da_resize(rs->output[i], frames * bytes * (planar ?
+					1 : rs->dst_channels));
+
+	/* swr's default matrix puts mono on both sides at -3dB */
+	if (rs->map == CHANNEL_MAP_UPMIX) {
+		float *mono = rs->filtered[0].array;
+		for (size_t i = 0; i < frames; i++)
+			mono[i] *= (float)M_SQRT1_2;
+	}
+
+	for (uint32_t ch = 0; ch < rs->dst_channels; ch++) {
+		const float *src = rs->filtered[
+			rs->map == CHANNEL_MAP_UPMIX ? 0 : ch].array;
+		uint8_t *dst = planar ?
+			rs->output[ch].array : rs->output[0].array + ch * bytes;
+
+		convert_from_float(dst, stride, src, frames, rs->dst.format);
+	}
+}
+
+bool native_resampler_resample(struct native_resampler *rs,
+		uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
+		const uint8_t *const input[], uint32_t in_frames)
+{
+	size_t frames;
+
+	if (rs->passthrough) {
+		for (uint32_t ch = 0; ch < rs->channels; ch++)
+			rs->filtered[ch].num = 0;
+
+		append_input(rs, input, in_frames);
+		frames = in_frames;
+		*ts_offset = 0;
+
+	} else {
+		/* time between the next output sample and the start of
+		 * this input, which is still sitting in the history */
+		double phase = (double)rs->pos.frac +
+			(double)rs->pos.sub / 4294967296.0 - 0.5;
+		double delay = (double)rs->buffers[0].num -
+			(double)(rs->pos.pos + rs->filter.taps / 2 - 1) -
+			phase / (double)rs->filter.phases;
+
+		/* the next output can already be past the history when the
+		 * step is large */
+		if (delay < 0.0)
+			delay = 0.0;
+
+		*ts_offset = (uint64_t)(delay * 1000000000.0 /
+				(double)rs->src.samples_per_sec);
+
+		append_input(rs, input, in_frames);
+		frames = filter_input(rs);
+	}
+
+	write_output(rs, frames);
+
+	for (uint32_t i = 0; i < rs->output_planes; i++)
+		output[i] = rs->output[i].array;
+
+	*out_frames = (uint32_t)frames;
+	return true;
+}
+
+bool native_resampler_set_compensation(struct native_resampler *rs,
+		double ratio)
+{
+	if (ratio <= 0.5 || ratio >= 2.0)
+		return false;
+
+	if (rs->passthrough) {
+		if (ratio == 1.0)
+			return true;
+
+		rs->passthrough = false;
+		init_filter(rs, 1, 1);
+	}
+
+	set_filter_step(rs, (double)rs->step / ratio);
+	return true;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "audio-resampler.h"
+
+/*
+ * In-tree polyphase resampler.  audio_resampler_create uses it in place of
+ * libswresample for the conversions it supports (any sample format, same
+ * speaker layout or mono <-> stereo, and rate pairs that reduce to a small
+ * enough ratio, such as 44.1khz <-> 48khz, downsampling by at most 4x).
+ */
+
+struct native_resampler;
+
+/* polyphase filter bank shared by the resampling kernels */
+struct resample_filter {
+	float    *coeffs;     /* phases * taps coefficients */
+	uint32_t taps;        /* always a multiple of 8 */
+	uint32_t phases;      /* interpolation factor */
+	uint32_t int_step;    /* whole input samples per output sample */
+	uint32_t frac_step;   /* remaining phases per output sample */
+	uint32_t sub_step;    /* remaining fraction of a phase (0.32 fixed
+	                       * point), only non-zero when compensating */
+};
+
+struct resample_pos {
+	size_t   pos;         /* input sample */
+	uint32_t frac;        /* phase */
+	uint32_t sub;         /* fraction of a phase */
+};
+
+/* returns NULL if the conversion is not supported */
+extern struct native_resampler *native_resampler_create(
+		const struct resample_info *dst,
+		const struct resample_info *src);
+extern void native_resampler_destroy(struct native_resampler *rs);
+extern bool native_resampler_resample(struct native_resampler *rs,
+		uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
+		const uint8_t *const input[], uint32_t in_frames);
+extern bool native_resampler_set_compensation(struct native_resampler *rs,
+		double ratio);
+
+/* filters src from the given position, and returns the number of samples
+ * written to dst (at most max_out).  stops once the filter would read past
+ * src_len */
+extern size_t resample_filter_run_avx(const struct resample_filter *filter,
+		float *dst, size_t max_out, const float *src, size_t src_len,
+		struct resample_pos *pos);
@@ -41,6 +41,14 @@ EXPORT bool audio_resampler_resample(audio_resampler_t *resampler,
 		 uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
 		 const uint8_t *const input[], uint32_t in_frames);
 
+/**
+ * Stretches the output by the given ratio (output samples per nominal output
+ * sample), used to compensate for clock drift between the input and output.
+ * 1.0 disables compensation.  Returns false if it could not be applied.
+ */
+EXPORT bool audio_resampler_set_compensation(audio_resampler_t *resampler,
+		double ratio);
+
 #ifdef __cplusplus
 }
 #endif
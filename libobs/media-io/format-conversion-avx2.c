@@ -0,0 +1,399 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "format-conversion-internal.h"
+#include <immintrin.h>
+
+/* AVX2 versions of the format conversion kernels.  They hand any columns
+ * left over after their last full vector to the scalar kernels.  This file
+ * must be compiled with AVX2 code generation enabled, and is only ever called
+ * when the CPU supports it. */
+
+/* ------------------------------------------------------------------------- */
+/* compression, 8 pixels of two lines per iteration */
+
+static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* packs the low bytes of two lines of 8 32bit values and stores them as 8
+ * contiguous bytes per line */
+static FORCE_INLINE void pack_lines(uint8_t *plane, uint32_t pos0,
+		uint32_t pos1, __m256i line1, __m256i line2)
+{
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m256i packed = _mm256_packs_epi32(line1, line2);
+	__m128i lo;
+
+	packed = _mm256_packus_epi16(packed, packed);
+	packed = _mm256_permutevar8x32_epi32(packed, order);
+	lo     = _mm256_castsi256_si128(packed);
+
+	_mm_storel_epi64((__m128i*)(plane + pos0), lo);
+	_mm_storel_epi64((__m128i*)(plane + pos1), _mm_srli_si128(lo, 8));
+}
+
+/* averages each 2x2 block of U/V values, returning 4 U/V pairs as 16bit
+ * values in dwords 0 and 1 of each 128bit lane */
+static FORCE_INLINE __m256i average_chroma(__m256i line1, __m256i line2)
+{
+	const __m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	__m256i sum = _mm256_add_epi16(
+			_mm256_and_si256(line1, uv_mask),
+			_mm256_and_si256(line2, uv_mask));
+
+	sum = _mm256_add_epi16(sum,
+			_mm256_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	sum = _mm256_srli_epi16(sum, 2);
+	return _mm256_shuffle_epi32(sum, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static FORCE_INLINE __m256i lum_values(__m256i line)
+{
+	return _mm256_and_si256(_mm256_srli_epi32(line, 8),
+			_mm256_set1_epi32(0xFF));
+}
+
+static inline void get_tail_planes(uint8_t *planes[], uint8_t *const output[],
+		uint32_t x, uint32_t chroma_x)
+{
+	planes[0] = output[0] + x;
+	planes[1] = output[1] + chroma_x;
+	planes[2] = output[2] ? output[2] + chroma_x : NULL;
+}
+
+void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t simd_width   = width & ~7;
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t uv_lo, uv_hi;
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+			__m256i uv;
+
+			pack_lines(lum_plane, lum_pos0, lum_pos1,
+					lum_values(line1), lum_values(line2));
+
+			uv = average_chroma(line1, line2);
+			uv = _mm256_shufflelo_epi16(uv, _MM_SHUFFLE(3, 1, 2, 0));
+			uv = _mm256_packus_epi16(uv, uv);
+
+			/* each lane now holds U0 U1 V0 V1 in its first dword */
+			uv_lo = (uint32_t)_mm256_extract_epi32(uv, 0);
+			uv_hi = (uint32_t)_mm256_extract_epi32(uv, 4);
+
+			*(uint32_t*)(u_plane + chroma_y_pos + (x>>1)) =
+				(uv_lo & 0xFFFF) | (uv_hi << 16);
+			*(uint32_t*)(v_plane + chroma_y_pos + (x>>1)) =
+				(uv_lo >> 16) | (uv_hi & 0xFFFF0000);
+		}
+	}
+
+	if (simd_width < width) {
+		uint8_t *planes[3];
+		get_tail_planes(planes, output, simd_width, simd_width>>1);
+		compress_uyvx_to_i420_c(input + simd_width*4, in_linesize,
+				start_y, end_y, width - simd_width,
+				planes, out_linesize);
+	}
+}
+
+void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t simd_width   = width & ~7;
+	uint32_t y;
+
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+			__m256i uv;
+
+			pack_lines(lum_plane, lum_pos0, lum_pos1,
+					lum_values(line1), lum_values(line2));
+
+			/* each lane holds U0 V0 U1 V1 in its first dword */
+			uv = average_chroma(line1, line2);
+			uv = _mm256_packus_epi16(uv, uv);
+			uv = _mm256_permutevar8x32_epi32(uv, order);
+
+			_mm_storel_epi64(
+				(__m128i*)(chroma_plane + chroma_y_pos + x),
+				_mm256_castsi256_si128(uv));
+		}
+	}
+
+	if (simd_width < width) {
+		uint8_t *planes[3];
+		get_tail_planes(planes, output, simd_width, simd_width);
+		compress_uyvx_to_nv12_c(input + simd_width*4, in_linesize,
+				start_y, end_y, width - simd_width,
+				planes, out_linesize);
+	}
+}
+
+void convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t simd_width   = width & ~7;
+	uint32_t y;
+
+	const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			pack_lines(lum_plane, lum_pos0, lum_pos1,
+					lum_values(line1), lum_values(line2));
+			pack_lines(u_plane, lum_pos0, lum_pos1,
+					_mm256_and_si256(line1, byte_mask),
+					_mm256_and_si256(line2, byte_mask));
+			pack_lines(v_plane, lum_pos0, lum_pos1,
+					_mm256_and_si256(
+						_mm256_srli_epi32(line1, 16),
+						byte_mask),
+					_mm256_and_si256(
+						_mm256_srli_epi32(line2, 16),
+						byte_mask));
+		}
+	}
+
+	if (simd_width < width) {
+		uint8_t *planes[3];
+		get_tail_planes(planes, output, simd_width, simd_width);
+		convert_uyvx_to_i444_c(input + simd_width*4, in_linesize,
+				start_y, end_y, width - simd_width,
+				planes, out_linesize);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* decompression, 16 pixels of two lines per iteration */
+
+/* expands 8 packed U/V dwords (U in byte 0, V in byte 1) so each one covers
+ * two neighbouring pixels, and moves them in to bytes 1 and 2 */
+static FORCE_INLINE void expand_chroma(__m256i uv, __m256i *lo, __m256i *hi)
+{
+	const __m256i lo_idx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	const __m256i hi_idx = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+	*lo = _mm256_slli_epi32(_mm256_permutevar8x32_epi32(uv, lo_idx), 8);
+	*hi = _mm256_slli_epi32(_mm256_permutevar8x32_epi32(uv, hi_idx), 8);
+}
+
+static FORCE_INLINE void store_line_avx2(uint32_t *output, const uint8_t *lum,
+		__m256i uv_lo, __m256i uv_hi)
+{
+	__m128i y = _mm_loadu_si128((const __m128i*)lum);
+
+	_mm256_storeu_si256((__m256i*)output,
+			_mm256_or_si256(_mm256_cvtepu8_epi32(y), uv_lo));
+	_mm256_storeu_si256((__m256i*)(output + 8),
+			_mm256_or_si256(
+				_mm256_cvtepu8_epi32(_mm_srli_si128(y, 8)),
+				uv_hi));
+}
+
+void decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t simd_width = width & ~15;
+	uint32_t y;
+
+	for (y = start_y/2; y < end_y/2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0    = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1    = lum0 + in_linesize[0];
+		uint32_t *output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		uint32_t *output1 = (uint32_t*)((uint8_t*)output0 +
+				out_linesize);
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 16) {
+			__m256i u = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+					(const __m128i*)(chroma0 + x/2)));
+			__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+					(const __m128i*)(chroma1 + x/2)));
+			__m256i uv_lo, uv_hi;
+
+			expand_chroma(_mm256_or_si256(u,
+						_mm256_slli_epi32(v, 8)),
+					&uv_lo, &uv_hi);
+
+			store_line_avx2(output0 + x, lum0 + x, uv_lo, uv_hi);
+			store_line_avx2(output1 + x, lum1 + x, uv_lo, uv_hi);
+		}
+	}
+
+	if (simd_width < width) {
+		const uint8_t *tail[3] = {
+			input[0] + simd_width,
+			input[1] + simd_width/2,
+			input[2] + simd_width/2
+		};
+
+		decompress_420_c(tail, in_linesize, start_y, end_y,
+				width - simd_width, output + simd_width*4,
+				out_linesize);
+	}
+}
+
+void decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t simd_width = width & ~15;
+	uint32_t y;
+
+	for (y = start_y/2; y < end_y/2; y++) {
+		const uint8_t *chroma  = input[1] + y * in_linesize[1];
+		const uint8_t *lum0    = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1    = lum0 + in_linesize[0];
+		uint32_t *output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		uint32_t *output1 = (uint32_t*)((uint8_t*)output0 +
+				out_linesize);
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 16) {
+			__m256i uv = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+					(const __m128i*)(chroma + x)));
+			__m256i uv_lo, uv_hi;
+
+			expand_chroma(uv, &uv_lo, &uv_hi);
+
+			store_line_avx2(output0 + x, lum0 + x, uv_lo, uv_hi);
+			store_line_avx2(output1 + x, lum1 + x, uv_lo, uv_hi);
+		}
+	}
+
+	if (simd_width < width) {
+		const uint8_t *tail[2] = {
+			input[0] + simd_width,
+			input[1] + simd_width
+		};
+
+		decompress_nv12_c(tail, in_linesize, start_y, end_y,
+				width - simd_width, output + simd_width*4,
+				out_linesize);
+	}
+}
+
+void decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	const __m256i keep_mask = leading_lum ?
+		_mm256_set1_epi32(0xFFFFFF00) : _mm256_set1_epi32(0xFFFF00FF);
+	const __m256i lum_mask  = leading_lum ?
+		_mm256_set1_epi32(0x000000FF) : _mm256_set1_epi32(0x0000FF00);
+	uint32_t simd_width = width & ~15;
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint8_t *in = input + y*in_linesize;
+		uint32_t *out = (uint32_t*)(output + y*out_linesize);
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 16) {
+			__m256i dw = _mm256_loadu_si256(
+					(const __m256i*)(in + x*2));
+			__m256i second = _mm256_or_si256(
+					_mm256_and_si256(dw, keep_mask),
+					_mm256_and_si256(
+						_mm256_srli_epi32(dw, 16),
+						lum_mask));
+
+			/* unpacking works per 128bit lane, so swap the
+			 * middle halves back in to pixel order */
+			__m256i lo = _mm256_unpacklo_epi32(dw, second);
+			__m256i hi = _mm256_unpackhi_epi32(dw, second);
+
+			_mm256_storeu_si256((__m256i*)(out + x),
+					_mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i*)(out + x + 8),
+					_mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+	}
+
+	if (simd_width < width)
+		decompress_422_c(input + simd_width*2, in_linesize,
+				start_y, end_y, width - simd_width,
+				output + simd_width*4, out_linesize,
+				leading_lum);
+}
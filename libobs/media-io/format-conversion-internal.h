@@ -0,0 +1,107 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * Internal kernels behind the format-conversion.h entry points.  The public
+ * functions pick the best variant for the CPU at runtime.
+ *
+ * The scalar kernels take an explicit width (in pixels) so the SIMD kernels
+ * can use them for any columns left over after their last full vector.  The
+ * decompression kernels all take an explicit width.
+ */
+
+extern void compress_uyvx_to_i420_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+extern void compress_uyvx_to_nv12_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+extern void convert_uyvx_to_i444_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+extern void decompress_420_c(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+extern void decompress_nv12_c(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+extern void decompress_422_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum);
+
+extern void decompress_420_sse2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+extern void decompress_nv12_sse2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+extern void decompress_422_sse2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum);
+
+extern void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+extern void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+extern void convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+extern void decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+extern void decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+extern void decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum);
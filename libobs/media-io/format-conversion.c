@@ -15,7 +15,10 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include "../util/threading.h"
+#include "../util/platform.h"
 #include "format-conversion.h"
+#include "format-conversion-internal.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
@@ -89,7 +92,7 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(
+static void compress_uyvx_to_i420_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -127,7 +130,7 @@ void compress_uyvx_to_i420(
 	}
 }
 
-void compress_uyvx_to_nv12(
+static void compress_uyvx_to_nv12_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -163,7 +166,7 @@ void compress_uyvx_to_nv12(
 	}
 }
 
-void convert_uyvx_to_i444(
+static void convert_uyvx_to_i444_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -202,13 +205,93 @@ void convert_uyvx_to_i444(
 	}
 }
 
-void decompress_420(
+/* ------------------------------------------------------------------------- */
+/* scalar reference kernels, also used for the leftover columns of the wider
+ * SIMD kernels */
+
+void compress_uyvx_to_i420_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *u    = output[1] + (y>>1) * out_linesize[1];
+		uint8_t *v    = output[2] + (y>>1) * out_linesize[2];
+
+		for (uint32_t x = 0; x < width; x += 2) {
+			const uint8_t *p1 = line1 + x*4;
+			const uint8_t *p2 = line2 + x*4;
+
+			lum0[x]   = p1[1];
+			lum0[x+1] = p1[5];
+			lum1[x]   = p2[1];
+			lum1[x+1] = p2[5];
+
+			u[x>>1] = (uint8_t)((p1[0] + p1[4] + p2[0] + p2[4]) >> 2);
+			v[x>>1] = (uint8_t)((p1[2] + p1[6] + p2[2] + p2[6]) >> 2);
+		}
+	}
+}
+
+void compress_uyvx_to_nv12_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *uv   = output[1] + (y>>1) * out_linesize[1];
+
+		for (uint32_t x = 0; x < width; x += 2) {
+			const uint8_t *p1 = line1 + x*4;
+			const uint8_t *p2 = line2 + x*4;
+
+			lum0[x]   = p1[1];
+			lum0[x+1] = p1[5];
+			lum1[x]   = p2[1];
+			lum1[x+1] = p2[5];
+
+			uv[x]   = (uint8_t)((p1[0] + p1[4] + p2[0] + p2[4]) >> 2);
+			uv[x+1] = (uint8_t)((p1[2] + p1[6] + p2[2] + p2[6]) >> 2);
+		}
+	}
+}
+
+void convert_uyvx_to_i444_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	for (uint32_t y = start_y; y < end_y; y++) {
+		const uint8_t *line = input + y * in_linesize;
+		uint8_t *lum = output[0] + y * out_linesize[0];
+		uint8_t *u   = output[1] + y * out_linesize[1];
+		uint8_t *v   = output[2] + y * out_linesize[2];
+
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t *p = line + x*4;
+
+			lum[x] = p[1];
+			u[x]   = p[0];
+			v[x]   = p[2];
+		}
+	}
+}
+
+void decompress_420_c(
 		const uint8_t *const input[], const uint32_t in_linesize[],
-		uint32_t start_y, uint32_t end_y,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
 		uint8_t *output, uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y/2;
-	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t width_d2   = width/2;
 	uint32_t height_d2  = end_y/2;
 	uint32_t y;
 
@@ -221,8 +304,8 @@ void decompress_420(
 
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * in_linesize[0]);
-		output1 = (uint32_t*)((uint8_t*)output0 + in_linesize[0]);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
 		for (x = 0; x < width_d2; x++) {
 			uint32_t out;
@@ -237,13 +320,13 @@ void decompress_420(
 	}
 }
 
-void decompress_nv12(
+void decompress_nv12_c(
 		const uint8_t *const input[], const uint32_t in_linesize[],
-		uint32_t start_y, uint32_t end_y,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
 		uint8_t *output, uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y/2;
-	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t width_d2   = width/2;
 	uint32_t height_d2  = end_y/2;
 	uint32_t y;
 
@@ -271,13 +354,13 @@ void decompress_nv12(
 	}
 }
 
-void decompress_422(
+void decompress_422_c(
 		const uint8_t *input, uint32_t in_linesize,
-		uint32_t start_y, uint32_t end_y,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
 		uint8_t *output, uint32_t out_linesize,
 		bool leading_lum)
 {
-	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	uint32_t width_d2 = width/2;
 	uint32_t y;
 
 	register const uint32_t *input32;
@@ -322,3 +405,307 @@ void decompress_422(
 		}
 	}
 }
+
+/* ------------------------------------------------------------------------- */
+/* SSE2 decompression kernels, 16 pixels per iteration */
+
+/* writes 16 pixels of Y with the given duplicated U/V bytes */
+static FORCE_INLINE void store_yuvx_sse2(uint32_t *output, __m128i lum,
+		__m128i u_dup, __m128i v_dup)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i yu_lo = _mm_unpacklo_epi8(lum, u_dup);
+	__m128i yu_hi = _mm_unpackhi_epi8(lum, u_dup);
+	__m128i v_lo  = _mm_unpacklo_epi8(v_dup, zero);
+	__m128i v_hi  = _mm_unpackhi_epi8(v_dup, zero);
+
+	_mm_storeu_si128((__m128i*)output,     _mm_unpacklo_epi16(yu_lo, v_lo));
+	_mm_storeu_si128((__m128i*)output + 1, _mm_unpackhi_epi16(yu_lo, v_lo));
+	_mm_storeu_si128((__m128i*)output + 2, _mm_unpacklo_epi16(yu_hi, v_hi));
+	_mm_storeu_si128((__m128i*)output + 3, _mm_unpackhi_epi16(yu_hi, v_hi));
+}
+
+static FORCE_INLINE void decompress_line_pair_sse2(
+		const uint8_t *lum0, const uint8_t *lum1,
+		uint32_t *output0, uint32_t *output1,
+		__m128i u8, __m128i v8)
+{
+	__m128i u_dup = _mm_unpacklo_epi8(u8, u8);
+	__m128i v_dup = _mm_unpacklo_epi8(v8, v8);
+
+	store_yuvx_sse2(output0, _mm_loadu_si128((const __m128i*)lum0),
+			u_dup, v_dup);
+	store_yuvx_sse2(output1, _mm_loadu_si128((const __m128i*)lum1),
+			u_dup, v_dup);
+}
+
+void decompress_420_sse2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t simd_width = width & ~15;
+	uint32_t y;
+
+	for (y = start_y/2; y < end_y/2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0    = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1    = lum0 + in_linesize[0];
+		uint32_t *output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		uint32_t *output1 = (uint32_t*)((uint8_t*)output0 +
+				out_linesize);
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 16) {
+			__m128i u8 = _mm_loadl_epi64(
+					(const __m128i*)(chroma0 + x/2));
+			__m128i v8 = _mm_loadl_epi64(
+					(const __m128i*)(chroma1 + x/2));
+
+			decompress_line_pair_sse2(lum0 + x, lum1 + x,
+					output0 + x, output1 + x, u8, v8);
+		}
+	}
+
+	if (simd_width < width) {
+		const uint8_t *tail[3] = {
+			input[0] + simd_width,
+			input[1] + simd_width/2,
+			input[2] + simd_width/2
+		};
+
+		decompress_420_c(tail, in_linesize, start_y, end_y,
+				width - simd_width, output + simd_width*4,
+				out_linesize);
+	}
+}
+
+void decompress_nv12_sse2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize)
+{
+	const __m128i zero    = _mm_setzero_si128();
+	const __m128i lo_mask = _mm_set1_epi16(0x00FF);
+	uint32_t simd_width = width & ~15;
+	uint32_t y;
+
+	for (y = start_y/2; y < end_y/2; y++) {
+		const uint8_t *chroma  = input[1] + y * in_linesize[1];
+		const uint8_t *lum0    = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1    = lum0 + in_linesize[0];
+		uint32_t *output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		uint32_t *output1 = (uint32_t*)((uint8_t*)output0 +
+				out_linesize);
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 16) {
+			__m128i uv = _mm_loadu_si128(
+					(const __m128i*)(chroma + x));
+			__m128i u8 = _mm_packus_epi16(
+					_mm_and_si128(uv, lo_mask), zero);
+			__m128i v8 = _mm_packus_epi16(
+					_mm_srli_epi16(uv, 8), zero);
+
+			decompress_line_pair_sse2(lum0 + x, lum1 + x,
+					output0 + x, output1 + x, u8, v8);
+		}
+	}
+
+	if (simd_width < width) {
+		const uint8_t *tail[2] = {
+			input[0] + simd_width,
+			input[1] + simd_width
+		};
+
+		decompress_nv12_c(tail, in_linesize, start_y, end_y,
+				width - simd_width, output + simd_width*4,
+				out_linesize);
+	}
+}
+
+void decompress_422_sse2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	/* the second pixel of each pair takes its luma from byte 2 (YUYV) or
+	 * byte 3 (UYVY) of the input dword */
+	const __m128i keep_mask = leading_lum ?
+		_mm_set1_epi32(0xFFFFFF00) : _mm_set1_epi32(0xFFFF00FF);
+	const __m128i lum_mask  = leading_lum ?
+		_mm_set1_epi32(0x000000FF) : _mm_set1_epi32(0x0000FF00);
+	uint32_t simd_width = width & ~7;
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint8_t *in = input + y*in_linesize;
+		uint32_t *out = (uint32_t*)(output + y*out_linesize);
+		uint32_t x;
+
+		for (x = 0; x < simd_width; x += 8) {
+			__m128i dw = _mm_loadu_si128(
+					(const __m128i*)(in + x*2));
+			__m128i second = _mm_or_si128(
+					_mm_and_si128(dw, keep_mask),
+					_mm_and_si128(_mm_srli_epi32(dw, 16),
+						lum_mask));
+
+			_mm_storeu_si128((__m128i*)(out + x),
+					_mm_unpacklo_epi32(dw, second));
+			_mm_storeu_si128((__m128i*)(out + x + 4),
+					_mm_unpackhi_epi32(dw, second));
+		}
+	}
+
+	if (simd_width < width)
+		decompress_422_c(input + simd_width*2, in_linesize,
+				start_y, end_y, width - simd_width,
+				output + simd_width*4, out_linesize,
+				leading_lum);
+}
+
+/* ------------------------------------------------------------------------- */
+/* runtime dispatch */
+
+typedef void (*compress_func_t)(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+typedef void (*decompress_planar_func_t)(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+typedef void (*decompress_packed_func_t)(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum);
+
+#define SCALAR_WRAPPER(name)                                                  \
+static void name##_scalar(                                                    \
+		const uint8_t *input, uint32_t in_linesize,                   \
+		uint32_t start_y, uint32_t end_y,                             \
+		uint8_t *output[], const uint32_t out_linesize[])             \
+{                                                                             \
+	name##_c(input, in_linesize, start_y, end_y,                          \
+			min_uint32(in_linesize, out_linesize[0]),             \
+			output, out_linesize);                                \
+}
+
+SCALAR_WRAPPER(compress_uyvx_to_i420)
+SCALAR_WRAPPER(compress_uyvx_to_nv12)
+SCALAR_WRAPPER(convert_uyvx_to_i444)
+
+static pthread_once_t  conversion_init_token = PTHREAD_ONCE_INIT;
+static compress_func_t compress_i420_func;
+static compress_func_t compress_nv12_func;
+static compress_func_t convert_i444_func;
+
+static decompress_planar_func_t decompress_420_func;
+static decompress_planar_func_t decompress_nv12_func;
+static decompress_packed_func_t decompress_422_func;
+
+static void init_conversion_funcs(void)
+{
+	uint32_t features = os_get_cpu_features();
+
+	if (features & OS_CPU_AVX2) {
+		compress_i420_func   = compress_uyvx_to_i420_avx2;
+		compress_nv12_func   = compress_uyvx_to_nv12_avx2;
+		convert_i444_func    = convert_uyvx_to_i444_avx2;
+		decompress_420_func  = decompress_420_avx2;
+		decompress_nv12_func = decompress_nv12_avx2;
+		decompress_422_func  = decompress_422_avx2;
+
+	} else if (features & OS_CPU_SSE2) {
+		compress_i420_func   = compress_uyvx_to_i420_sse2;
+		compress_nv12_func   = compress_uyvx_to_nv12_sse2;
+		convert_i444_func    = convert_uyvx_to_i444_sse2;
+		decompress_420_func  = decompress_420_sse2;
+		decompress_nv12_func = decompress_nv12_sse2;
+		decompress_422_func  = decompress_422_sse2;
+
+	} else {
+		compress_i420_func   = compress_uyvx_to_i420_scalar;
+		compress_nv12_func   = compress_uyvx_to_nv12_scalar;
+		convert_i444_func    = convert_uyvx_to_i444_scalar;
+		decompress_420_func  = decompress_420_c;
+		decompress_nv12_func = decompress_nv12_c;
+		decompress_422_func  = decompress_422_c;
+	}
+}
+
+void compress_uyvx_to_i420(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	pthread_once(&conversion_init_token, init_conversion_funcs);
+	compress_i420_func(input, in_linesize, start_y, end_y,
+			output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	pthread_once(&conversion_init_token, init_conversion_funcs);
+	compress_nv12_func(input, in_linesize, start_y, end_y,
+			output, out_linesize);
+}
+
+void convert_uyvx_to_i444(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	pthread_once(&conversion_init_token, init_conversion_funcs);
+	convert_i444_func(input, in_linesize, start_y, end_y,
+			output, out_linesize);
+}
+
+/* the output is 32bit per pixel, so the width is limited by whichever of the
+ * luma input or the output lines is smaller */
+
+void decompress_420(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t width = min_uint32(in_linesize[0], out_linesize/4);
+
+	pthread_once(&conversion_init_token, init_conversion_funcs);
+	decompress_420_func(input, in_linesize, start_y, end_y, width,
+			output, out_linesize);
+}
+
+void decompress_nv12(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t width = min_uint32(in_linesize[0], out_linesize/4);
+
+	pthread_once(&conversion_init_token, init_conversion_funcs);
+	decompress_nv12_func(input, in_linesize, start_y, end_y, width,
+			output, out_linesize);
+}
+
+void decompress_422(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	uint32_t width = min_uint32(in_linesize/2, out_linesize/4);
+
+	pthread_once(&conversion_init_token, init_conversion_funcs);
+	decompress_422_func(input, in_linesize, start_y, end_y, width,
+			output, out_linesize, leading_lum);
+}
@@ -16,41 +16,84 @@
 ******************************************************************************/
 
 #include <assert.h>
+#include <inttypes.h>
 #include "../util/bmem.h"
 #include "../util/platform.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf.h"
 
 #include "format-conversion.h"
 #include "video-io.h"
 #include "video-frame.h"
 #include "video-scaler.h"
 
-#define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_QUEUED_FRAMES 3
 
 struct cached_frame_info {
 	struct video_data frame;
 	int count;
+
+	/* one reference is held by video-io until the frame is dispatched,
+	 * plus one for every input queue entry that points to it */
+	long refs;
+	bool pending;
+
+	/* unique for every frame output, used to match up scaled frames */
+	uint64_t serial;
+
+	/* if the frame data was lent by the caller instead of being written
+	 * to the cached buffers, the buffers are stored here until the frame
+	 * is released */
+	struct video_frame owned;
+	void (*release)(void *param);
+	void *release_param;
+};
+
+struct queued_frame {
+	size_t   cache_idx;
+	uint64_t timestamp;
+};
+
+struct scaled_frame {
+	struct video_frame        frame;
+	uint64_t                  serial;
+	long                      users;
+};
+
+/* inputs that request the same conversion share a scaler and its output,
+ * so each distinct conversion is only done once per frame */
+struct video_conversion {
+	struct video_scale_info   info;
+	video_scaler_t            *scaler;
+	pthread_mutex_t           mutex;
+	DARRAY(struct scaled_frame*) frames;
+	long                      refs;
 };
 
+struct video_output;
+
 struct video_input {
+	struct video_output       *video;
 	struct video_scale_info   conversion;
-	video_scaler_t            *scaler;
-	struct video_frame        frame[MAX_CONVERT_BUFFERS];
-	int                       cur_frame;
+	struct video_conversion   *convert;
+
+	/* each input runs its callback on its own thread so that a slow
+	 * input (such as an encoder) cannot stall any of the others */
+	pthread_t                 thread;
+	os_sem_t                  *frame_sem;
+	struct circlebuf          frames;
+	bool                      thread_initialized;
+	volatile bool             stop;
+	bool                      detached;
+	uint32_t                  skipped_frames;
+	uint32_t                  total_frames;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
 };
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
-
 struct video_output {
 	struct video_output_info   info;
 
@@ -59,6 +102,7 @@ struct video_output {
 	bool                       stop;
 
 	os_sem_t                   *update_semaphore;
+	os_event_t                 *frame_released;
 	uint64_t                   frame_time;
 	uint32_t                   skipped_frames;
 	uint32_t                   total_frames;
@@ -66,94 +110,292 @@ struct video_output {
 	bool                       initialized;
 
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input*)inputs;
+	DARRAY(struct video_conversion*) conversions;
+
+	/* inputs that disconnected from within their own callback and clean
+	 * up on their own threads.  each of them posts detached_sem once it
+	 * has finished */
+	volatile long              detached_inputs;
+	os_sem_t                   *detached_sem;
 
 	size_t                     available_frames;
-	size_t                     first_added;
 	size_t                     last_added;
+	uint64_t                   last_serial;
+	struct circlebuf           pending_frames;
 	struct cached_frame_info   cache[MAX_CACHE_SIZE];
 };
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-		struct video_data *data)
+static void return_lent_frame(struct cached_frame_info *cfi)
 {
-	bool success = true;
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		cfi->frame.data[i]     = cfi->owned.data[i];
+		cfi->frame.linesize[i] = cfi->owned.linesize[i];
+	}
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	cfi->release(cfi->release_param);
+	cfi->release = NULL;
+	cfi->release_param = NULL;
+}
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+/* must be called with data_mutex locked */
+static inline void release_cached_frame(struct video_output *video,
+		size_t idx)
+{
+	struct cached_frame_info *cfi = &video->cache[idx];
 
-		frame = &input->frame[input->cur_frame];
+	if (--cfi->refs == 0) {
+		if (cfi->release)
+			return_lent_frame(cfi);
+		video->available_frames++;
 
-		success = video_scaler_scale(input->scaler,
-				frame->data, frame->linesize,
-				(const uint8_t * const*)data->data,
-				data->linesize);
+		if (video->info.offline)
+			os_event_signal(video->frame_released);
+	}
+}
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i]     = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
+static bool video_conversion_scale(struct video_conversion *convert,
+		struct scaled_frame *scaled, const struct video_data *data)
+{
+	if (!scaled->frame.data[0])
+		video_frame_init(&scaled->frame, convert->info.format,
+				convert->info.width, convert->info.height);
+
+	return video_scaler_scale(convert->scaler,
+			scaled->frame.data, scaled->frame.linesize,
+			(const uint8_t * const*)data->data, data->linesize);
+}
+
+/* returns the scaled version of the frame, scaling it if no other input
+ * has done so already.  release with release_scaled_frame. */
+static struct scaled_frame *get_scaled_frame(
+		struct video_conversion *convert,
+		const struct video_data *data, uint64_t serial)
+{
+	struct scaled_frame *scaled = NULL;
+	struct scaled_frame *unused = NULL;
+
+	pthread_mutex_lock(&convert->mutex);
+
+	for (size_t i = 0; i < convert->frames.num; i++) {
+		struct scaled_frame *cur = convert->frames.array[i];
+
+		if (cur->serial == serial) {
+			scaled = cur;
+			break;
+		}
+
+		if (!cur->users && (!unused || cur->serial < unused->serial))
+			unused = cur;
+	}
+
+	if (!scaled) {
+		if (!unused) {
+			unused = bzalloc(sizeof(*unused));
+			da_push_back(convert->frames, &unused);
+		}
+
+		if (video_conversion_scale(convert, unused, data)) {
+			unused->serial = serial;
+			scaled = unused;
 		} else {
+			unused->serial = 0;
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
 		}
 	}
 
-	return success;
+	if (scaled)
+		scaled->users++;
+
+	pthread_mutex_unlock(&convert->mutex);
+	return scaled;
 }
 
-static inline bool video_output_cur_frame(struct video_output *video)
+static inline void release_scaled_frame(struct video_conversion *convert,
+		struct scaled_frame *scaled)
 {
-	struct cached_frame_info *frame_info;
-	bool complete;
+	pthread_mutex_lock(&convert->mutex);
+	scaled->users--;
+	pthread_mutex_unlock(&convert->mutex);
+}
 
-	/* -------------------------------- */
+static void video_input_process_frame(struct video_input *input)
+{
+	struct video_output *video = input->video;
+	struct scaled_frame *scaled = NULL;
+	struct cached_frame_info *cfi;
+	struct queued_frame queued;
+	struct video_data frame;
 
 	pthread_mutex_lock(&video->data_mutex);
+	circlebuf_peek_front(&input->frames, &queued, sizeof(queued));
+	pthread_mutex_unlock(&video->data_mutex);
+
+	/* the cache entry cannot be reused while this input holds a
+	 * reference to it, so it's safe to read it without the lock */
+	cfi = &video->cache[queued.cache_idx];
+	frame = cfi->frame;
+	frame.timestamp = queued.timestamp;
+
+	if (input->convert) {
+		scaled = get_scaled_frame(input->convert, &frame, cfi->serial);
+
+		if (scaled) {
+			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+				frame.data[i]     = scaled->frame.data[i];
+				frame.linesize[i] = scaled->frame.linesize[i];
+			}
 
-	frame_info = &video->cache[video->first_added];
+			input->callback(input->param, &frame);
+			release_scaled_frame(input->convert, scaled);
+		}
+	} else {
+		input->callback(input->param, &frame);
+	}
 
+	pthread_mutex_lock(&video->data_mutex);
+	circlebuf_pop_front(&input->frames, NULL, sizeof(queued));
+	release_cached_frame(video, queued.cache_idx);
 	pthread_mutex_unlock(&video->data_mutex);
+}
 
-	/* -------------------------------- */
+static void video_conversion_release(struct video_output *video,
+		struct video_conversion *convert);
+static void video_input_free(struct video_input *input);
 
-	pthread_mutex_lock(&video->input_mutex);
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
 
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
-		struct video_data frame = frame_info->frame;
+	os_set_thread_name("video-io: input thread");
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+	while (os_sem_wait(input->frame_sem) == 0) {
+		if (os_atomic_load_bool(&input->stop))
+			break;
+
+		video_input_process_frame(input);
 	}
 
-	pthread_mutex_unlock(&video->input_mutex);
+	/* an input that disconnects itself from within its own callback
+	 * cannot be joined, so it cleans up after itself instead, and
+	 * video_output_close waits for it to finish */
+	if (input->detached) {
+		struct video_output *video = input->video;
 
-	/* -------------------------------- */
+		video_input_free(input);
+		os_sem_post(video->detached_sem);
+	}
+
+	return NULL;
+}
+
+static void video_input_free(struct video_input *input)
+{
+	struct video_output *video = input->video;
+
+	if (input->thread_initialized && !input->detached) {
+		os_atomic_set_bool(&input->stop, true);
+		os_sem_post(input->frame_sem);
+		pthread_join(input->thread, NULL);
+	}
 
 	pthread_mutex_lock(&video->data_mutex);
+	while (input->frames.size) {
+		struct queued_frame queued;
+		circlebuf_pop_front(&input->frames, &queued, sizeof(queued));
+		release_cached_frame(video, queued.cache_idx);
+	}
+	pthread_mutex_unlock(&video->data_mutex);
 
-	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
+	if (input->skipped_frames)
+		blog(LOG_INFO, "video-io: input skipped %"PRIu32" of "
+				"%"PRIu32" frames",
+				input->skipped_frames, input->total_frames);
 
-	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
+	if (input->convert)
+		video_conversion_release(video, input->convert);
+	circlebuf_free(&input->frames);
+	os_sem_destroy(input->frame_sem);
+	bfree(input);
+}
+
+/* must be called with data_mutex locked, returns false if the input's
+ * queue was full and the frame was skipped */
+static inline bool video_input_push_frame(struct video_output *video,
+		struct video_input *input, size_t idx, uint64_t timestamp)
+{
+	struct queued_frame queued = {idx, timestamp};
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+	input->total_frames++;
+
+	/* in offline mode the queue is bounded by the cache size instead, as
+	 * video_output_lock_frame waits for inputs to release frames */
+	if (os_atomic_load_bool(&input->stop) || (!video->info.offline &&
+	    input->frames.size / sizeof(queued) >= MAX_QUEUED_FRAMES)) {
+		input->skipped_frames++;
+		return false;
 	}
 
+	circlebuf_push_back(&input->frames, &queued, sizeof(queued));
+	video->cache[idx].refs++;
+	os_sem_post(input->frame_sem);
+	return true;
+}
+
+static inline void video_output_cur_frame(struct video_output *video)
+{
+	struct cached_frame_info *frame_info;
+	size_t idx;
+	int count;
+	int input_skipped = 0;
+
+	/* -------------------------------- */
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	circlebuf_pop_front(&video->pending_frames, &idx, sizeof(idx));
+	frame_info = &video->cache[idx];
+	frame_info->pending = false;
+	count = frame_info->count;
+
 	pthread_mutex_unlock(&video->data_mutex);
 
 	/* -------------------------------- */
 
-	return complete;
+	pthread_mutex_lock(&video->input_mutex);
+	pthread_mutex_lock(&video->data_mutex);
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array[i];
+		uint64_t timestamp = frame_info->frame.timestamp;
+		int skipped = 0;
+
+		for (int j = 0; j < count; j++) {
+			if (!video_input_push_frame(video, input, idx,
+						timestamp))
+				skipped++;
+			timestamp += video->frame_time;
+		}
+
+		if (skipped > input_skipped)
+			input_skipped = skipped;
+	}
+
+	release_cached_frame(video, idx);
+
+	/* frames an input (such as a lagging encoder) had to skip count as
+	 * skipped output frames too, taking the worst input so that a frame
+	 * skipped by several inputs is only counted once */
+	if (input_skipped < count - 1)
+		input_skipped = count - 1;
+
+	video->total_frames   += count;
+	video->skipped_frames += input_skipped;
+
+	pthread_mutex_unlock(&video->data_mutex);
+	pthread_mutex_unlock(&video->input_mutex);
 }
 
 static void *video_thread(void *param)
@@ -166,12 +408,7 @@ static void *video_thread(void *param)
 		if (video->stop)
 			break;
 
-		while (!video->stop && !video_output_cur_frame(video)) {
-			video->total_frames++;
-			video->skipped_frames++;
-		}
-
-		video->total_frames++;
+		video_output_cur_frame(video);
 	}
 
 	return NULL;
@@ -228,6 +465,10 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail;
+	if (os_event_init(&out->frame_released, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (os_sem_init(&out->detached_sem, 0) != 0)
+		goto fail;
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
 		goto fail;
 
@@ -249,14 +490,25 @@ void video_output_close(video_t *video)
 
 	video_output_stop(video);
 
+	for (long i = os_atomic_load_long(&video->detached_inputs); i > 0; i--)
+		os_sem_wait(video->detached_sem);
+
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
 	da_free(video->inputs);
+	da_free(video->conversions);
 
-	for (size_t i = 0; i < video->info.cache_size; i++)
+	/* frames that were never sent out still need to be given back */
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		if (video->cache[i].release)
+			return_lent_frame(&video->cache[i]);
 		video_frame_free((struct video_frame*)&video->cache[i]);
+	}
+	circlebuf_free(&video->pending_frames);
 
 	os_sem_destroy(video->update_semaphore);
+	os_event_destroy(video->frame_released);
+	os_sem_destroy(video->detached_sem);
 	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
 	bfree(video);
@@ -267,7 +519,7 @@ static size_t video_get_input_idx(const video_t *video,
 		void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -275,39 +527,125 @@ static size_t video_get_input_idx(const video_t *video,
 	return DARRAY_INVALID;
 }
 
+static inline bool scale_info_equal(const struct video_scale_info *a,
+		const struct video_scale_info *b)
+{
+	return a->format     == b->format &&
+	       a->width      == b->width  &&
+	       a->height     == b->height &&
+	       a->range      == b->range  &&
+	       a->colorspace == b->colorspace;
+}
+
+static void video_conversion_destroy(struct video_conversion *convert)
+{
+	for (size_t i = 0; i < convert->frames.num; i++) {
+		struct scaled_frame *scaled = convert->frames.array[i];
+		video_frame_free(&scaled->frame);
+		bfree(scaled);
+	}
+
+	da_free(convert->frames);
+	video_scaler_destroy(convert->scaler);
+	pthread_mutex_destroy(&convert->mutex);
+	bfree(convert);
+}
+
+static struct video_conversion *video_conversion_create(
+		struct video_output *video,
+		const struct video_scale_info *info)
+{
+	struct video_conversion *convert = bzalloc(sizeof(*convert));
+	struct video_scale_info from = {
+		.format = video->info.format,
+		.width  = video->info.width,
+		.height = video->info.height,
+	};
+	int ret;
+
+	convert->info = *info;
+
+	if (pthread_mutex_init(&convert->mutex, NULL) != 0) {
+		bfree(convert);
+		return NULL;
+	}
+
+	ret = video_scaler_create(&convert->scaler, info, &from,
+			VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+			                "scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+			                "create scaler");
+
+		video_conversion_destroy(convert);
+		return NULL;
+	}
+
+	return convert;
+}
+
+/* must be called with input_mutex locked */
+static struct video_conversion *video_conversion_get(
+		struct video_output *video,
+		const struct video_scale_info *info)
+{
+	struct video_conversion *convert;
+
+	for (size_t i = 0; i < video->conversions.num; i++) {
+		convert = video->conversions.array[i];
+
+		if (scale_info_equal(&convert->info, info)) {
+			convert->refs++;
+			return convert;
+		}
+	}
+
+	convert = video_conversion_create(video, info);
+	if (convert) {
+		convert->refs = 1;
+		da_push_back(video->conversions, &convert);
+	}
+
+	return convert;
+}
+
+static void video_conversion_release(struct video_output *video,
+		struct video_conversion *convert)
+{
+	bool destroy;
+
+	pthread_mutex_lock(&video->input_mutex);
+	destroy = --convert->refs == 0;
+	if (destroy)
+		da_erase_item(video->conversions, &convert);
+	pthread_mutex_unlock(&video->input_mutex);
+
+	if (destroy)
+		video_conversion_destroy(convert);
+}
+
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
 	if (input->conversion.width  != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {
-			.format = video->info.format,
-			.width  = video->info.width,
-			.height = video->info.height,
-		};
-
-		int ret = video_scaler_create(&input->scaler,
-				&input->conversion, &from,
-				VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-				                "scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-				                "create scaler");
-
+		input->convert = video_conversion_get(video,
+				&input->conversion);
+		if (!input->convert)
 			return false;
-		}
-
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					input->conversion.format,
-					input->conversion.width,
-					input->conversion.height);
 	}
 
+	if (os_sem_init(&input->frame_sem, 0) != 0)
+		return false;
+	if (pthread_create(&input->thread, NULL, video_input_thread,
+				input) != 0)
+		return false;
+
+	input->thread_initialized = true;
 	return true;
 }
 
@@ -324,28 +662,30 @@ bool video_output_connect(video_t *video,
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param    = param;
+		input->video    = video;
+		input->callback = callback;
+		input->param    = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format    = video->info.format;
-			input.conversion.width     = video->info.width;
-			input.conversion.height    = video->info.height;
+			input->conversion.format    = video->info.format;
+			input->conversion.width     = video->info.width;
+			input->conversion.height    = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success)
 			da_push_back(video->inputs, &input);
+		else
+			video_input_free(input);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -360,15 +700,33 @@ void video_output_disconnect(video_t *video,
 	if (!video || !callback)
 		return;
 
+	struct video_input *input = NULL;
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array+idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	if (!input)
+		return;
+
+	/* an input may disconnect from within its own callback (for example
+	 * when an encoder fails), in which case its thread frees it */
+	if (input->thread_initialized &&
+	    pthread_equal(pthread_self(), input->thread)) {
+		os_atomic_inc_long(&video->detached_inputs);
+		input->detached = true;
+		os_atomic_set_bool(&input->stop, true);
+		pthread_detach(input->thread);
+		os_sem_post(input->frame_sem);
+	} else {
+		video_input_free(input);
+	}
 }
 
 bool video_output_active(const video_t *video)
@@ -392,19 +750,41 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 
 	pthread_mutex_lock(&video->data_mutex);
 
+	if (video->info.offline) {
+		while (video->available_frames == 0 && !video->stop) {
+			pthread_mutex_unlock(&video->data_mutex);
+			os_event_wait(video->frame_released);
+			pthread_mutex_lock(&video->data_mutex);
+		}
+	}
+
 	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
+		/* if the last frame hasn't been sent out yet, just repeat it,
+		 * otherwise every cached frame is still held by inputs */
+		cfi = &video->cache[video->last_added];
+		if (cfi->pending) {
+			cfi->count += count;
+		} else {
+			video->total_frames   += count;
+			video->skipped_frames += count;
+		}
+
 		locked = false;
 
 	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
+		for (size_t i = 0; i < video->info.cache_size; i++) {
+			if (video->cache[i].refs == 0) {
+				video->last_added = i;
+				break;
+			}
 		}
 
 		cfi = &video->cache[video->last_added];
 		cfi->frame.timestamp = timestamp;
+		cfi->serial = ++video->last_serial;
 		cfi->count = count;
+		cfi->refs = 1;
+		cfi->pending = true;
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
@@ -423,6 +803,38 @@ void video_output_unlock_frame(video_t *video)
 	pthread_mutex_lock(&video->data_mutex);
 
 	video->available_frames--;
+	circlebuf_push_back(&video->pending_frames, &video->last_added,
+			sizeof(video->last_added));
+	os_sem_post(video->update_semaphore);
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
+void video_output_unlock_frame_lent(video_t *video,
+		const struct video_frame *frame,
+		void (*release)(void *param), void *param)
+{
+	struct cached_frame_info *cfi;
+
+	if (!video) return;
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	cfi = &video->cache[video->last_added];
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		cfi->owned.data[i]     = cfi->frame.data[i];
+		cfi->owned.linesize[i] = cfi->frame.linesize[i];
+		cfi->frame.data[i]     = frame->data[i];
+		cfi->frame.linesize[i] = frame->linesize[i];
+	}
+
+	cfi->release       = release;
+	cfi->release_param = param;
+
+	video->available_frames--;
+	circlebuf_push_back(&video->pending_frames, &video->last_added,
+			sizeof(video->last_added));
 	os_sem_post(video->update_semaphore);
 
 	pthread_mutex_unlock(&video->data_mutex);
@@ -444,6 +856,7 @@ void video_output_stop(video_t *video)
 		video->initialized = false;
 		video->stop = true;
 		os_sem_post(video->update_semaphore);
+		os_event_signal(video->frame_released);
 		pthread_join(video->thread, &thread_ret);
 	}
 }
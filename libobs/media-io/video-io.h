@@ -81,6 +81,9 @@ struct video_output_info {
 
 	enum video_colorspace colorspace;
 	enum video_range_type range;
+
+	/* wait for inputs instead of dropping frames when they fall behind */
+	bool              offline;
 };
 
 static inline bool format_is_yuv(enum video_format format)
@@ -165,6 +168,18 @@ EXPORT const struct video_output_info *video_output_get_info(
 EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		int count, uint64_t timestamp);
 EXPORT void video_output_unlock_frame(video_t *video);
+
+/**
+ * Unlocks a frame locked with video_output_lock_frame, but sends the given
+ * frame data to the inputs instead of the locked frame's buffers, without
+ * copying it.  The data must stay valid until the release callback is called,
+ * which happens once every input is done with the frame.  The callback can
+ * be called from any thread and must not call back in to the video output.
+ */
+EXPORT void video_output_unlock_frame_lent(video_t *video,
+		const struct video_frame *frame,
+		void (*release)(void *param), void *param);
+
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <math.h>
+#include <xmmintrin.h>
 
 #include "util/threading.h"
 #include "util/bmem.h"
@@ -66,10 +67,15 @@ struct obs_volmeter {
 	unsigned int           ival_frames;
 	float                  ival_sum;
 	float                  ival_max;
+	bool                   muted;
 
 	float                  vol_peak;
 	float                  vol_mag;
 	float                  vol_max;
+
+	/* only used by obs_volmeter_send_levels */
+	struct signal_info     *levels_signal;
+	calldata_t             levels_data;
 };
 
 static const char *fader_signals[] = {
@@ -206,24 +212,20 @@ static void signal_volume_changed(signal_handler_t *sh,
 	calldata_free(&data);
 }
 
-static void signal_levels_updated(signal_handler_t *sh,
-		struct obs_volmeter *volmeter,
-		const float level, const float magnitude, const float peak,
-		bool muted)
+/* the calldata is kept in the volume meter and reused, this is only called
+ * from obs_volmeter_send_levels */
+static void signal_levels_updated(struct obs_volmeter *volmeter,
+		const struct obs_volmeter_levels *levels)
 {
-	struct calldata data;
-
-	calldata_init(&data);
-
-	calldata_set_ptr  (&data, "volmeter",  volmeter);
-	calldata_set_float(&data, "level",     level);
-	calldata_set_float(&data, "magnitude", magnitude);
-	calldata_set_float(&data, "peak",      peak);
-	calldata_set_bool (&data, "muted",     muted);
+	calldata_t *data = &volmeter->levels_data;
 
-	signal_handler_signal(sh, "levels_updated", &data);
+	calldata_set_ptr  (data, "volmeter",  volmeter);
+	calldata_set_float(data, "level",     levels->level);
+	calldata_set_float(data, "magnitude", levels->magnitude);
+	calldata_set_float(data, "peak",      levels->peak);
+	calldata_set_bool (data, "muted",     levels->muted);
 
-	calldata_free(&data);
+	signal_signal(volmeter->levels_signal, data);
 }
 
 static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
@@ -280,22 +282,41 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 static void volmeter_sum_and_max(float *data[MAX_AV_PLANES], size_t frames,
 		float *sum, float *max)
 {
-	float s  = *sum;
+	const size_t frames4 = frames & ~(size_t)3;
+	__m128 sum4 = _mm_setzero_ps();
+	__m128 max4 = _mm_set1_ps(*max);
+	float s  = 0.0f;
 	float m  = *max;
+	float out[4];
 
 	for (size_t plane = 0; plane < MAX_AV_PLANES; plane++) {
-		if (!data[plane])
+		const float *c = data[plane];
+		if (!c)
 			break;
 
-		for (float *c = data[plane]; c < data[plane] + frames; ++c) {
+		for (const float *end = c + frames4; c < end; c += 4) {
+			__m128 val = _mm_loadu_ps(c);
+			__m128 pow = _mm_mul_ps(val, val);
+			sum4 = _mm_add_ps(sum4, pow);
+			max4 = _mm_max_ps(max4, pow);
+		}
+
+		for (const float *end = data[plane] + frames; c < end; ++c) {
 			const float pow = *c * *c;
 			s += pow;
 			m  = (m > pow) ? m : pow;
 		}
 	}
 
-	*sum = s;
-	*max = m;
+	_mm_storeu_ps(out, sum4);
+	s += (out[0] + out[1]) + (out[2] + out[3]);
+
+	_mm_storeu_ps(out, max4);
+	for (size_t i = 0; i < 4; i++)
+		m = (m > out[i]) ? m : out[i];
+
+	*sum += s;
+	*max  = m;
 }
 
 /**
@@ -334,73 +355,53 @@ static void volmeter_calc_ival_levels(obs_volmeter_t *volmeter)
 	volmeter->ival_max    = 0.0f;
 }
 
-static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
-		struct audio_data *data)
+/* the audio of a source is only accumulated as it arrives, the levels are
+ * calculated from it once per update interval by obs_volmeter_send_levels */
+static void volmeter_source_data_received(void *vptr, obs_source_t *source,
+		const struct audio_data *data, bool muted)
 {
-	bool updated   = false;
-	size_t frames  = 0;
-	size_t left    = data->frames;
+	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
 	float *adata[MAX_AV_PLANES];
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		adata[i] = (float*)data->data[i];
 
-	while (left) {
-		frames  = (volmeter->ival_frames + left >
-				volmeter->update_frames)
-			? volmeter->update_frames - volmeter->ival_frames
-			: left;
-
-		volmeter_sum_and_max(adata, frames, &volmeter->ival_sum,
-				&volmeter->ival_max);
-
-		volmeter->ival_frames += (unsigned int)frames;
-		left                  -= frames;
-
-		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-			if (!adata[i])
-				break;
-			adata[i] += frames;
-		}
+	pthread_mutex_lock(&volmeter->mutex);
 
-		/* break if we did not reach the end of the interval */
-		if (volmeter->ival_frames != volmeter->update_frames)
-			break;
+	volmeter_sum_and_max(adata, data->frames, &volmeter->ival_sum,
+			&volmeter->ival_max);
+	volmeter->ival_frames += data->frames;
+	volmeter->muted        = muted;
 
-		volmeter_calc_ival_levels(volmeter);
-		updated = true;
-	}
+	pthread_mutex_unlock(&volmeter->mutex);
 
-	return updated;
+	UNUSED_PARAMETER(source);
 }
 
-static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
+/* called with the volume meter mutex held, returns false if the current
+ * update interval is not over yet */
+static bool volmeter_update_levels(struct obs_volmeter *volmeter,
+		struct obs_volmeter_levels *levels)
 {
-	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
-	bool updated = false;
-	float mul, level, mag, peak;
-	signal_handler_t *sh;
-
-	pthread_mutex_lock(&volmeter->mutex);
-
-	struct audio_data *data = calldata_ptr(calldata, "data");
-	updated = volmeter_process_audio_data(volmeter, data);
+	float mul;
 
-	if (updated) {
-		mul   = db_to_mul(volmeter->cur_db);
+	if (!volmeter->ival_frames ||
+	    volmeter->ival_frames < volmeter->update_frames)
+		return false;
 
-		level = volmeter->db_to_pos(mul_to_db(volmeter->vol_max * mul));
-		mag   = volmeter->db_to_pos(mul_to_db(volmeter->vol_mag * mul));
-		peak  = volmeter->db_to_pos(
-				mul_to_db(volmeter->vol_peak * mul));
-		sh    = volmeter->signals;
-	}
+	volmeter_calc_ival_levels(volmeter);
 
-	pthread_mutex_unlock(&volmeter->mutex);
+	mul = db_to_mul(volmeter->cur_db);
 
-	if (updated)
-		signal_levels_updated(sh, volmeter, level, mag, peak,
-				calldata_bool(calldata, "muted"));
+	levels->volmeter  = volmeter;
+	levels->level     = volmeter->db_to_pos(
+			mul_to_db(volmeter->vol_max * mul));
+	levels->magnitude = volmeter->db_to_pos(
+			mul_to_db(volmeter->vol_mag * mul));
+	levels->peak      = volmeter->db_to_pos(
+			mul_to_db(volmeter->vol_peak * mul));
+	levels->muted     = volmeter->muted;
+	return true;
 }
 
 static void volmeter_update_audio_settings(obs_volmeter_t *volmeter)
@@ -623,6 +624,9 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 	if (!signal_handler_add_array(volmeter->signals, volmeter_signals))
 		goto fail;
 
+	volmeter->levels_signal = signal_handler_get_signal(volmeter->signals,
+			"levels_updated");
+
 	/* set conversion functions */
 	switch(type) {
 	case OBS_FADER_CUBIC:
@@ -646,6 +650,10 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 	obs_volmeter_set_update_interval(volmeter, 50);
 	obs_volmeter_set_peak_hold(volmeter, 1500);
 
+	pthread_mutex_lock(&obs->data.volmeters_mutex);
+	da_push_back(obs->data.volmeters, &volmeter);
+	pthread_mutex_unlock(&obs->data.volmeters_mutex);
+
 	return volmeter;
 fail:
 	obs_volmeter_destroy(volmeter);
@@ -657,8 +665,15 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 	if (!volmeter)
 		return;
 
+	if (obs) {
+		pthread_mutex_lock(&obs->data.volmeters_mutex);
+		da_erase_item(obs->data.volmeters, &volmeter);
+		pthread_mutex_unlock(&obs->data.volmeters_mutex);
+	}
+
 	obs_volmeter_detach_source(volmeter);
 	signal_handler_destroy(volmeter->signals);
+	calldata_free(&volmeter->levels_data);
 	pthread_mutex_destroy(&volmeter->mutex);
 
 	bfree(volmeter);
@@ -674,19 +689,19 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 	obs_volmeter_detach_source(volmeter);
 
 	pthread_mutex_lock(&volmeter->mutex);
+	volmeter->source = source;
+	volmeter->cur_db = mul_to_db(obs_source_get_volume(source));
+	pthread_mutex_unlock(&volmeter->mutex);
 
+	/* connected outside of the volume meter mutex, the callbacks lock it
+	 * while the source holds its own callback locks */
 	sh = obs_source_get_signal_handler(source);
 	signal_handler_connect(sh, "volume",
 			volmeter_source_volume_changed, volmeter);
-	signal_handler_connect(sh, "audio_data",
-			volmeter_source_data_received, volmeter);
 	signal_handler_connect(sh, "destroy",
 			volmeter_source_destroyed, volmeter);
-
-	volmeter->source = source;
-	volmeter->cur_db = mul_to_db(obs_source_get_volume(source));
-
-	pthread_mutex_unlock(&volmeter->mutex);
+	obs_source_add_audio_capture_callback(source,
+			volmeter_source_data_received, volmeter);
 
 	return true;
 }
@@ -694,27 +709,26 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 {
 	signal_handler_t *sh;
+	obs_source_t *source;
 
 	if (!volmeter)
 		return;
 
 	pthread_mutex_lock(&volmeter->mutex);
+	source = volmeter->source;
+	volmeter->source = NULL;
+	pthread_mutex_unlock(&volmeter->mutex);
 
-	if (!volmeter->source)
-		goto exit;
+	if (!source)
+		return;
 
-	sh = obs_source_get_signal_handler(volmeter->source);
+	sh = obs_source_get_signal_handler(source);
 	signal_handler_disconnect(sh, "volume",
 			volmeter_source_volume_changed, volmeter);
-	signal_handler_disconnect(sh, "audio_data",
-			volmeter_source_data_received, volmeter);
 	signal_handler_disconnect(sh, "destroy",
 			volmeter_source_destroyed, volmeter);
-
-	volmeter->source = NULL;
-
-exit:
-	pthread_mutex_unlock(&volmeter->mutex);
+	obs_source_remove_audio_capture_callback(source,
+			volmeter_source_data_received, volmeter);
 }
 
 signal_handler_t *obs_volmeter_get_signal_handler(obs_volmeter_t *volmeter)
@@ -768,3 +782,83 @@ unsigned int obs_volmeter_get_peak_hold(obs_volmeter_t *volmeter)
 
 	return peakhold;
 }
+
+void obs_add_volmeter_levels_callback(
+		obs_volmeter_levels_callback_t callback, void *param)
+{
+	struct volmeter_levels_callback data = {callback, param};
+
+	if (!obs || !callback)
+		return;
+
+	pthread_mutex_lock(&obs->data.volmeters_mutex);
+	da_push_back(obs->data.volmeter_callbacks, &data);
+	pthread_mutex_unlock(&obs->data.volmeters_mutex);
+}
+
+void obs_remove_volmeter_levels_callback(
+		obs_volmeter_levels_callback_t callback, void *param)
+{
+	struct volmeter_levels_callback data = {callback, param};
+
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->data.volmeters_mutex);
+	da_erase_item(obs->data.volmeter_callbacks, &data);
+	pthread_mutex_unlock(&obs->data.volmeters_mutex);
+}
+
+/**
+ * Called once per frame from the graphics thread.  Calculates the levels of
+ * every volume meter whose update interval is over from the audio gathered
+ * since the last update, hands them to the batch callbacks in one go and
+ * emits levels_updated for volume meters that still have it connected.
+ * Neither happens with a volume meter mutex held.  The volume meter list
+ * stays locked meanwhile so that none of the reported volume meters can be
+ * destroyed.
+ */
+void obs_volmeter_send_levels(void)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->volmeters_mutex);
+
+	da_resize(data->volmeter_levels, 0);
+
+	for (size_t i = 0; i < data->volmeters.num; i++) {
+		struct obs_volmeter *volmeter = data->volmeters.array[i];
+		struct obs_volmeter_levels levels;
+		bool updated;
+
+		pthread_mutex_lock(&volmeter->mutex);
+		updated = volmeter_update_levels(volmeter, &levels);
+		pthread_mutex_unlock(&volmeter->mutex);
+
+		if (updated)
+			da_push_back(data->volmeter_levels, &levels);
+	}
+
+	if (!data->volmeter_levels.num) {
+		pthread_mutex_unlock(&data->volmeters_mutex);
+		return;
+	}
+
+	for (size_t i = 0; i < data->volmeter_callbacks.num; i++) {
+		struct volmeter_levels_callback *cb;
+		cb = data->volmeter_callbacks.array+i;
+
+		cb->callback(cb->param, data->volmeter_levels.array,
+				data->volmeter_levels.num);
+	}
+
+	for (size_t i = 0; i < data->volmeter_levels.num; i++) {
+		struct obs_volmeter_levels *levels =
+			data->volmeter_levels.array + i;
+
+		if (signal_has_callbacks(levels->volmeter->levels_signal))
+			signal_levels_updated(levels->volmeter, levels);
+	}
+
+	pthread_mutex_unlock(&data->volmeters_mutex);
+}
@@ -204,6 +204,10 @@ EXPORT void obs_volmeter_detach_source(obs_volmeter_t *volmeter);
  * @brief Get signal handler for the volume meter object
  * @param volmeter pointer to the volume meter object
  * @return signal handler
+ *
+ * The levels_updated signal is emitted from the graphics thread once per
+ * update interval, after the batched callbacks were called. New code should
+ * use obs_add_volmeter_levels_callback instead.
  */
 EXPORT signal_handler_t *obs_volmeter_get_signal_handler(
 		obs_volmeter_t *volmeter);
@@ -251,6 +255,55 @@ EXPORT void obs_volmeter_set_peak_hold(obs_volmeter_t *volmeter,
  */
 EXPORT unsigned int obs_volmeter_get_peak_hold(obs_volmeter_t *volmeter);
 
+/**
+ * @brief Levels of a single volume meter
+ *
+ * The values are the same as the ones emitted by the levels_updated signal.
+ */
+struct obs_volmeter_levels {
+	obs_volmeter_t *volmeter;
+	float          level;
+	float          magnitude;
+	float          peak;
+	bool           muted;
+};
+
+/**
+ * @brief Callback receiving the levels of all updated volume meters
+ * @param param user data passed when adding the callback
+ * @param levels array of updated levels, one entry per volume meter
+ * @param count number of entries in the array
+ *
+ * The array is only valid for the duration of the callback.
+ */
+typedef void (*obs_volmeter_levels_callback_t)(void *param,
+		const struct obs_volmeter_levels *levels, size_t count);
+
+/**
+ * @brief Add a callback for batched volume meter updates
+ * @param callback the callback to add
+ * @param param user data passed to the callback
+ *
+ * Instead of connecting to the levels_updated signal of every volume meter,
+ * a GUI may register a single callback that receives the levels of all volume
+ * meters at once. The callback is called from the graphics thread at most
+ * once per frame, and only with the volume meters whose update interval
+ * ended since the previous call, so it is effectively called at the update
+ * interval of the volume meters.
+ * The volume meters in the array are guaranteed to stay valid until the
+ * callback returns, volume meters must not be destroyed from within it.
+ */
+EXPORT void obs_add_volmeter_levels_callback(
+		obs_volmeter_levels_callback_t callback, void *param);
+
+/**
+ * @brief Remove a callback for batched volume meter updates
+ * @param callback the callback to remove
+ * @param param user data that was passed when adding the callback
+ */
+EXPORT void obs_remove_volmeter_levels_callback(
+		obs_volmeter_levels_callback_t callback, void *param);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,217 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs.h"
+#include "obs-internal.h"
+
+/*
+ * Process-wide pool of idle async frames.  Sources take frames from the pool
+ * when they need a new frame for their async cache and give them back when
+ * they no longer use them, so that sources with the same format and size
+ * (and a single source switching back and forth between resolutions) reuse
+ * each other's buffers instead of allocating new ones.
+ *
+ * Idle frames are kept in least recently used order, oldest first.  Frames
+ * are freed from the front of the list when the pool goes over its memory
+ * limit or when they have been idle for too long.
+ */
+
+#define FRAME_POOL_DEFAULT_LIMIT (256ULL * 1024ULL * 1024ULL)
+#define FRAME_POOL_MAX_IDLE_TIME 10000000000ULL
+
+static size_t frame_size(enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	size_t pixels = (size_t)width * (size_t)height;
+
+	switch (format) {
+	case VIDEO_FORMAT_NONE:
+		return 0;
+
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+		return pixels + pixels / 2;
+
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		return pixels * 2;
+
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return pixels * 4;
+
+	case VIDEO_FORMAT_I444:
+		return pixels * 3;
+	}
+
+	return 0;
+}
+
+static struct obs_source_frame *pool_frame_create(enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	struct async_source_frame *af = bzalloc(sizeof(*af));
+
+	obs_source_frame_init(&af->frame, format, width, height);
+	return &af->frame;
+}
+
+static void pool_frame_destroy(struct obs_source_frame *frame)
+{
+	struct async_source_frame *af = get_async_source_frame(frame);
+
+	bfree(af->frame.data[0]);
+	bfree(af);
+}
+
+static void free_frame_entry(struct obs_frame_pool *pool, size_t idx)
+{
+	struct frame_pool_entry *entry = pool->frames.array + idx;
+
+	pool->size -= entry->size;
+	pool_frame_destroy(entry->frame);
+	da_erase(pool->frames, idx);
+}
+
+static void trim_frame_pool(struct obs_frame_pool *pool, uint64_t ts)
+{
+	while (pool->frames.num) {
+		struct frame_pool_entry *oldest = pool->frames.array;
+
+		if (pool->size <= pool->limit &&
+		    ts - oldest->last_used < FRAME_POOL_MAX_IDLE_TIME)
+			break;
+
+		free_frame_entry(pool, 0);
+	}
+}
+
+bool obs_frame_pool_init(struct obs_frame_pool *pool)
+{
+	memset(pool, 0, sizeof(*pool));
+	pool->limit = (size_t)FRAME_POOL_DEFAULT_LIMIT;
+
+	pthread_mutex_init_value(&pool->mutex);
+	return pthread_mutex_init(&pool->mutex, NULL) == 0;
+}
+
+void obs_frame_pool_free(struct obs_frame_pool *pool)
+{
+	while (pool->frames.num)
+		free_frame_entry(pool, pool->frames.num - 1);
+
+	da_free(pool->frames);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+struct obs_source_frame *obs_frame_pool_get(struct obs_frame_pool *pool,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame = NULL;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	trim_frame_pool(pool, os_gettime_ns());
+
+	/* most recently released frames first, they are the most likely to
+	 * still be in the cache */
+	for (size_t i = pool->frames.num; i > 0; i--) {
+		struct frame_pool_entry *entry = pool->frames.array + (i - 1);
+		struct obs_source_frame *cur = entry->frame;
+
+		if (cur->format == format &&
+		    cur->width  == width &&
+		    cur->height == height) {
+			frame = cur;
+			pool->size -= entry->size;
+			da_erase(pool->frames, i - 1);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!frame)
+		frame = pool_frame_create(format, width, height);
+
+	frame->refs = 0;
+	return frame;
+}
+
+void obs_frame_pool_release(struct obs_frame_pool *pool,
+		struct obs_source_frame *frame)
+{
+	struct frame_pool_entry *entry;
+	size_t size;
+
+	if (!frame)
+		return;
+
+	size = frame_size(frame->format, frame->width, frame->height);
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if (size > pool->limit) {
+		pthread_mutex_unlock(&pool->mutex);
+		pool_frame_destroy(frame);
+		return;
+	}
+
+	entry = da_push_back_new(pool->frames);
+	entry->frame     = frame;
+	entry->size      = size;
+	entry->last_used = os_gettime_ns();
+	pool->size += size;
+
+	trim_frame_pool(pool, entry->last_used);
+
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void obs_set_async_frame_pool_limit(uint64_t bytes)
+{
+	struct obs_frame_pool *pool;
+
+	if (!obs)
+		return;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->limit = (size_t)bytes;
+	trim_frame_pool(pool, os_gettime_ns());
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+uint64_t obs_get_async_frame_pool_limit(void)
+{
+	struct obs_frame_pool *pool;
+	uint64_t limit;
+
+	if (!obs)
+		return 0;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	limit = (uint64_t)pool->limit;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return limit;
+}
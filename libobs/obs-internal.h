@@ -30,11 +30,15 @@
 
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
+#include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
 
 #include "obs.h"
 
-#define NUM_TEXTURES 2
+#define MAX_TEXTURES 5
+#define DEFAULT_TEXTURES 2
+#define MAX_CONVERT_THREADS 7
+#define MAX_LENT_SURFACES 8
 #define MICROSECOND_DEN 1000000
 
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
@@ -195,16 +199,59 @@ struct obs_vframe_info {
 	int count;
 };
 
+/* layout of the planes of a GPU converted frame, which are packed in to an
+ * RGBA texture of width x conversion_height */
+struct obs_conversion_layout {
+	const char                      *tech;
+	uint32_t                        width;
+	uint32_t                        height;
+	uint32_t                        conversion_height;
+	uint32_t                        plane_offsets[3];
+	uint32_t                        plane_sizes[3];
+	uint32_t                        plane_linewidth[3];
+};
+
+/* an additional output of the main view at a different resolution, rendered
+ * and converted on the GPU alongside the main output */
+struct obs_rendition {
+	video_t                         *video;
+	uint32_t                        width;
+	uint32_t                        height;
+	struct obs_conversion_layout    conversion;
+
+	gs_texture_t                    *output_textures[MAX_TEXTURES];
+	gs_texture_t                    *convert_textures[MAX_TEXTURES];
+	gs_stagesurf_t                  *copy_surfaces[MAX_TEXTURES];
+	bool                            textures_output[MAX_TEXTURES];
+	bool                            textures_converted[MAX_TEXTURES];
+	bool                            textures_copied[MAX_TEXTURES];
+
+	/* surfaces mapped and handed to the copy thread, and ones it's done
+	 * with that need to be unmapped (under lent_surfaces_mutex) */
+	bool                            surfaces_out[MAX_TEXTURES];
+	bool                            surfaces_returned[MAX_TEXTURES];
+
+	/* freed by the graphics thread once no surfaces are out */
+	bool                            removed;
+};
+
+struct obs_convert_thread {
+	pthread_t                       thread;
+	os_sem_t                        *start_sem;
+	uint32_t                        start_y;
+	uint32_t                        end_y;
+};
+
 struct obs_core_video {
 	graphics_t                      *graphics;
-	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
-	gs_texture_t                    *render_textures[NUM_TEXTURES];
-	gs_texture_t                    *output_textures[NUM_TEXTURES];
-	gs_texture_t                    *convert_textures[NUM_TEXTURES];
-	bool                            textures_rendered[NUM_TEXTURES];
-	bool                            textures_output[NUM_TEXTURES];
-	bool                            textures_copied[NUM_TEXTURES];
-	bool                            textures_converted[NUM_TEXTURES];
+	gs_stagesurf_t                  *copy_surfaces[MAX_TEXTURES];
+	gs_texture_t                    *render_textures[MAX_TEXTURES];
+	gs_texture_t                    *output_textures[MAX_TEXTURES];
+	gs_texture_t                    *convert_textures[MAX_TEXTURES];
+	bool                            textures_rendered[MAX_TEXTURES];
+	bool                            textures_output[MAX_TEXTURES];
+	bool                            textures_copied[MAX_TEXTURES];
+	bool                            textures_converted[MAX_TEXTURES];
 	struct circlebuf                vframe_info_buffer;
 	gs_effect_t                     *default_effect;
 	gs_effect_t                     *default_rect_effect;
@@ -214,20 +261,25 @@ struct obs_core_video {
 	gs_effect_t                     *bicubic_effect;
 	gs_effect_t                     *lanczos_effect;
 	gs_effect_t                     *bilinear_lowres_effect;
-	gs_stagesurf_t                  *mapped_surface;
 	int                             cur_texture;
+	int                             num_textures;
 
 	uint64_t                        video_time;
 	video_t                         *video;
 	pthread_t                       video_thread;
 	bool                            thread_initialized;
 
+	/* mapped surfaces are copied/converted in to video-io on this thread
+	 * so the graphics thread only has to render */
+	pthread_t                       copy_thread;
+	bool                            copy_thread_initialized;
+	os_sem_t                        *copy_sem;
+	pthread_mutex_t                 copy_mutex;
+	struct circlebuf                copy_queue;
+	volatile bool                   copy_stop;
+
 	bool                            gpu_conversion;
-	const char                      *conversion_tech;
-	uint32_t                        conversion_height;
-	uint32_t                        plane_offsets[3];
-	uint32_t                        plane_sizes[3];
-	uint32_t                        plane_linewidth[3];
+	struct obs_conversion_layout    conversion;
 
 	uint32_t                        output_width;
 	uint32_t                        output_height;
@@ -235,6 +287,29 @@ struct obs_core_video {
 	uint32_t                        base_height;
 	float                           color_matrix[16];
 	enum obs_scale_type             scale_type;
+	bool                            offline;
+
+	/* slice-parallel CPU conversion (only used without GPU conversion);
+	 * the graphics thread converts the first slice itself */
+	struct obs_convert_thread       convert_threads[MAX_CONVERT_THREADS];
+	size_t                          num_convert_threads;
+	uint32_t                        convert_end_y;
+	os_sem_t                        *convert_done_sem;
+	volatile bool                   convert_stop;
+	struct video_frame              convert_output;
+	const struct video_data         *convert_input;
+
+	/* mapped surfaces out with the copy thread or lent to video-io.
+	 * returned surfaces are unmapped on the graphics thread and reused */
+	pthread_mutex_t                 lent_surfaces_mutex;
+	size_t                          num_lent_surfaces;
+	DARRAY(gs_stagesurf_t*)         returned_surfaces;
+	DARRAY(gs_stagesurf_t*)         spare_surfaces;
+	os_event_t                      *surface_returned;
+
+	/* sorted from largest to smallest */
+	pthread_mutex_t                 renditions_mutex;
+	DARRAY(struct obs_rendition*)   renditions;
 
 	struct obs_display              main_display;
 };
@@ -247,6 +322,33 @@ struct obs_core_audio {
 	float                           present_volume;
 };
 
+/* process-wide pool of idle async frames, see obs-frame-pool.c.  The pool
+ * hands out frames allocated as struct async_source_frame */
+struct frame_pool_entry {
+	struct obs_source_frame         *frame;
+	size_t                          size;
+	uint64_t                        last_used;
+};
+
+struct obs_frame_pool {
+	pthread_mutex_t                 mutex;
+	DARRAY(struct frame_pool_entry) frames;
+	size_t                          size;
+	size_t                          limit;
+};
+
+extern bool obs_frame_pool_init(struct obs_frame_pool *pool);
+extern void obs_frame_pool_free(struct obs_frame_pool *pool);
+extern struct obs_source_frame *obs_frame_pool_get(struct obs_frame_pool *pool,
+		enum video_format format, uint32_t width, uint32_t height);
+extern void obs_frame_pool_release(struct obs_frame_pool *pool,
+		struct obs_source_frame *frame);
+
+struct volmeter_levels_callback {
+	obs_volmeter_levels_callback_t  callback;
+	void                            *param;
+};
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	pthread_mutex_t                 user_sources_mutex;
@@ -266,6 +368,15 @@ struct obs_core_data {
 
 	struct obs_view                 main_view;
 
+	/* volume meters and batched level updates, see
+	 * obs_volmeter_send_levels */
+	pthread_mutex_t                 volmeters_mutex;
+	DARRAY(struct obs_volmeter*)    volmeters;
+	DARRAY(struct volmeter_levels_callback) volmeter_callbacks;
+	DARRAY(struct obs_volmeter_levels) volmeter_levels;
+
+	struct obs_frame_pool           frame_pool;
+
 	volatile long                   active_transitions;
 
 	long long                       unnamed_index;
@@ -337,6 +448,10 @@ struct obs_core {
 extern struct obs_core *obs;
 
 extern void *obs_video_thread(void *param);
+extern void *obs_convert_thread(void *param);
+extern void *obs_copy_thread(void *param);
+extern void obs_rendition_destroy(struct obs_rendition *r);
+extern void obs_volmeter_send_levels(void);
 
 
 /* ------------------------------------------------------------------------- */
@@ -427,11 +542,51 @@ struct async_frame {
 	bool used;
 };
 
+#define MAX_ASYNC_FRAMES 30
+
+/* fixed-capacity ring of queued async frames, in output order */
+struct async_frame_queue {
+	struct obs_source_frame *frames[MAX_ASYNC_FRAMES];
+	size_t start;
+	size_t num;
+};
+
+/* every frame queued on an async source is allocated as one of these, so
+ * the libobs-only state can be reached from the obs_source_frame pointer */
+struct async_source_frame {
+	struct obs_source_frame    frame;
+
+	/* index of the frame's slot in the source's async cache */
+	size_t                     cache_idx;
+
+	/* set for frames passed to obs_source_output_video_owned, the data
+	 * stays with the producer until release is called */
+	obs_source_frame_release_t release;
+	void                       *param;
+};
+
+static inline struct async_source_frame *get_async_source_frame(
+		struct obs_source_frame *frame)
+{
+	return (struct async_source_frame*)frame;
+}
+
+static inline bool async_frame_owned(struct obs_source_frame *frame)
+{
+	return get_async_source_frame(frame)->release != NULL;
+}
+
 struct obs_weak_source {
 	struct obs_weak_ref ref;
 	struct obs_source *source;
 };
 
+struct audio_cb_info {
+	obs_source_audio_capture_t callback;
+	void *param;
+	bool remove;
+};
+
 struct obs_source {
 	struct obs_context_data         context;
 	struct obs_source_info          info;
@@ -478,7 +633,22 @@ struct obs_source {
 	struct resample_info            sample_info;
 	audio_resampler_t               *resampler;
 	audio_line_t                    *audio_line;
+
+	/* clock drift compensation: compares the time covered by the
+	 * source's timestamps against the time covered by its samples, and
+	 * stretches the resampler output to match */
+	uint64_t                        drift_start_ts;
+	uint64_t                        drift_next_update;
+	uint64_t                        drift_in_frames;
+	uint64_t                        drift_out_frames;
+	double                          drift_offset;
+	double                          drift_ratio;
 	pthread_mutex_t                 audio_mutex;
+	pthread_mutex_t                 audio_cb_mutex;
+	DARRAY(struct audio_cb_info)    audio_cb_list;
+	volatile long                   audio_cb_count;
+	bool                            audio_cb_signalling;
+	struct signal_info              *audio_data_signal;
 	struct obs_audio_data           audio_data;
 	size_t                          audio_storage_size;
 	float                           base_volume;
@@ -502,7 +672,7 @@ struct obs_source {
 	bool                            async_flip;
 	bool                            async_active;
 	DARRAY(struct async_frame)      async_cache;
-	DARRAY(struct obs_source_frame*)async_frames;
+	struct async_frame_queue        async_frames;
 	pthread_mutex_t                 async_mutex;
 	uint32_t                        async_width;
 	uint32_t                        async_height;
@@ -520,6 +690,9 @@ struct obs_source {
 	enum obs_allow_direct_render    allow_direct;
 	bool                            rendering_filter;
 
+	/* per-frame render cache, see OBS_SOURCE_FLAG_CACHE_RENDER */
+	gs_texrender_t                  *render_cache;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id              mute_unmute_key;
 	obs_hotkey_id                   push_to_mute_key;
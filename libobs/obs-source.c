@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include <inttypes.h>
+#include <math.h>
 
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
@@ -89,7 +90,7 @@ static const char *source_signals[] = {
 	"void update_properties(ptr source)",
 	"void update_flags(ptr source, int flags)",
 	"void audio_sync(ptr source, int out int offset)",
-	"void audio_data(ptr source, ptr data, bool muted)",
+	"void audio_data(ptr source, ptr data, bool muted)", /* deprecated */
 	"void audio_mixers(ptr source, in out int mixers)",
 	"void filter_add(ptr source, ptr filter)",
 	"void filter_remove(ptr source, ptr filter)",
@@ -128,6 +129,7 @@ bool obs_source_init(struct obs_source *source,
 	pthread_mutex_init_value(&source->filter_mutex);
 	pthread_mutex_init_value(&source->async_mutex);
 	pthread_mutex_init_value(&source->audio_mutex);
+	pthread_mutex_init_value(&source->audio_cb_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -137,6 +139,8 @@ bool obs_source_init(struct obs_source *source,
 		return false;
 	if (pthread_mutex_init(&source->audio_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&source->audio_cb_mutex, &attr) != 0)
+		return false;
 	if (pthread_mutex_init(&source->async_mutex, NULL) != 0)
 		return false;
 
@@ -150,6 +154,9 @@ bool obs_source_init(struct obs_source *source,
 		}
 	}
 
+	source->audio_data_signal = signal_handler_get_signal(
+			source->context.signals, "audio_data");
+
 	source->control = bzalloc(sizeof(obs_weak_source_t));
 	source->control->source = source;
 
@@ -325,10 +332,71 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+static inline struct obs_source_frame *async_queue_peek(
+		const struct async_frame_queue *queue, size_t idx)
+{
+	return queue->frames[(queue->start + idx) % MAX_ASYNC_FRAMES];
+}
+
+static inline bool async_queue_push(struct async_frame_queue *queue,
+		struct obs_source_frame *frame)
+{
+	if (queue->num == MAX_ASYNC_FRAMES)
+		return false;
+
+	queue->frames[(queue->start + queue->num++) % MAX_ASYNC_FRAMES] = frame;
+	return true;
+}
+
+static inline struct obs_source_frame *async_queue_pop(
+		struct async_frame_queue *queue)
+{
+	struct obs_source_frame *frame = queue->frames[queue->start];
+
+	queue->start = (queue->start + 1) % MAX_ASYNC_FRAMES;
+	queue->num--;
+	return frame;
+}
+
+static inline void async_queue_clear(struct async_frame_queue *queue)
+{
+	queue->start = 0;
+	queue->num   = 0;
+}
+
+/* called when the last reference of an async frame is gone */
+static void free_async_frame(struct obs_source_frame *frame)
+{
+	struct async_source_frame *af = get_async_source_frame(frame);
+
+	if (af->release) {
+		af->release(af->param);
+		bfree(af);
+	} else {
+		obs_frame_pool_release(&obs->data.frame_pool, frame);
+	}
+}
+
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		free_async_frame(frame);
+}
+
+/* owned frames are not part of the cache, the queue holds their reference
+ * instead */
+static void release_owned_frames(obs_source_t *source)
+{
+	for (size_t i = 0; i < source->async_frames.num; i++) {
+		struct obs_source_frame *frame =
+			async_queue_peek(&source->async_frames, i);
+		if (async_frame_owned(frame))
+			obs_source_frame_decref(frame);
+	}
+
+	if (source->cur_async_frame &&
+	    async_frame_owned(source->cur_async_frame))
+		obs_source_frame_decref(source->cur_async_frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -365,6 +433,8 @@ void obs_source_destroy(struct obs_source *source)
 	obs_hotkey_unregister(source->push_to_mute_key);
 	obs_hotkey_pair_unregister(source->mute_unmute_key);
 
+	release_owned_frames(source);
+
 	for (i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
 
@@ -372,6 +442,7 @@ void obs_source_destroy(struct obs_source *source)
 	gs_texrender_destroy(source->async_convert_texrender);
 	gs_texture_destroy(source->async_texture);
 	gs_texrender_destroy(source->filter_texrender);
+	gs_texrender_destroy(source->render_cache);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
@@ -381,10 +452,11 @@ void obs_source_destroy(struct obs_source *source)
 	audio_resampler_destroy(source->resampler);
 
 	da_free(source->async_cache);
-	da_free(source->async_frames);
 	da_free(source->filters);
+	da_free(source->audio_cb_list);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
+	pthread_mutex_destroy(&source->audio_cb_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
 	obs_context_data_free(&source->context);
 
@@ -775,32 +847,69 @@ static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
 static void remove_async_frame(obs_source_t *source,
 		struct obs_source_frame *frame);
 
-void obs_source_video_tick(obs_source_t *source, float seconds)
+/*
+ * A hidden source is not rendered, so its frames are never uploaded.  Rather
+ * than letting them wait in the queue, release all of them right away except
+ * the newest one, which is kept as the current frame so it can be uploaded as
+ * soon as the source is shown again.
+ */
+static void skip_hidden_async_frames(obs_source_t *source)
 {
-	bool now_showing, now_active;
+	struct async_frame_queue *queue = &source->async_frames;
 
-	if (!source) return;
+	while (queue->num) {
+		remove_async_frame(source, source->cur_async_frame);
+		source->cur_async_frame = async_queue_pop(queue);
+	}
 
-	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0) {
-		uint64_t sys_time = obs->video.video_time;
+	/* restart frame timing when the source is shown again */
+	source->last_frame_ts = 0;
+}
 
-		pthread_mutex_lock(&source->async_mutex);
-		if (source->cur_async_frame) {
+static void tick_async_frames(obs_source_t *source)
+{
+	uint64_t sys_time = obs->video.video_time;
+	struct obs_source_frame *frame;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	/* show references alone do not tell whether a source is visible, as
+	 * a hidden scene item keeps its source showing.  a source that was
+	 * not rendered since the last tick is treated as hidden as well */
+	if (!source->show_refs || !source->async_rendered) {
+		skip_hidden_async_frames(source);
+
+	} else {
+		/* only replace a current frame that has not been rendered
+		 * yet if there's a newer one */
+		frame = get_closest_frame(source, sys_time);
+		if (frame) {
 			remove_async_frame(source, source->cur_async_frame);
-			source->cur_async_frame = NULL;
+			source->cur_async_frame = frame;
 		}
-
-		source->cur_async_frame = get_closest_frame(source, sys_time);
-		source->last_sys_timestamp = sys_time;
-		pthread_mutex_unlock(&source->async_mutex);
 	}
 
+	source->last_sys_timestamp = sys_time;
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+void obs_source_video_tick(obs_source_t *source, float seconds)
+{
+	bool now_showing, now_active;
+
+	if (!source) return;
+
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0)
+		tick_async_frames(source);
+
 	if (source->defer_update)
 		obs_source_deferred_update(source);
 
 	/* reset the filter render texture information once every frame */
 	if (source->filter_texrender)
 		gs_texrender_reset(source->filter_texrender);
+	if (source->render_cache)
+		gs_texrender_reset(source->render_cache);
 
 	/* call show/hide if the reference changed */
 	now_showing = !!source->show_refs;
@@ -864,22 +973,58 @@ static inline void handle_ts_jump(obs_source_t *source, uint64_t expected,
 		reset_audio_timing(source, ts, os_time);
 }
 
-static void source_signal_audio_data(obs_source_t *source,
-		struct audio_data *in, bool muted)
+/* deprecated in favor of audio capture callbacks, only built if something
+ * is still connected to it */
+static void source_signal_audio_data_deprecated(obs_source_t *source,
+		const struct audio_data *in, bool muted)
 {
 	struct calldata data;
 
+	if (!signal_has_callbacks(source->audio_data_signal))
+		return;
+
 	calldata_init(&data);
 
 	calldata_set_ptr(&data, "source", source);
-	calldata_set_ptr(&data, "data",   in);
+	calldata_set_ptr(&data, "data",   (void*)in);
 	calldata_set_bool(&data, "muted", muted);
 
-	signal_handler_signal(source->context.signals, "audio_data", &data);
+	signal_signal(source->audio_data_signal, &data);
 
 	calldata_free(&data);
 }
 
+static void source_signal_audio_data(obs_source_t *source,
+		const struct audio_data *in, bool muted)
+{
+	/* the count mirrors the number of connected callbacks so that
+	 * sources without capture callbacks do not have to touch the mutex at
+	 * all.  the mutex is recursive and callbacks removed while they are
+	 * being called are only marked, so that a callback can remove itself
+	 * or others, the same way signals are handled */
+	if (os_atomic_load_long(&source->audio_cb_count)) {
+		pthread_mutex_lock(&source->audio_cb_mutex);
+		source->audio_cb_signalling = true;
+
+		for (size_t i = 0; i < source->audio_cb_list.num; i++) {
+			struct audio_cb_info info =
+				source->audio_cb_list.array[i];
+			if (!info.remove)
+				info.callback(info.param, source, in, muted);
+		}
+
+		for (size_t i = source->audio_cb_list.num; i > 0; i--) {
+			if (source->audio_cb_list.array[i - 1].remove)
+				da_erase(source->audio_cb_list, i - 1);
+		}
+
+		source->audio_cb_signalling = false;
+		pthread_mutex_unlock(&source->audio_cb_mutex);
+	}
+
+	source_signal_audio_data_deprecated(source, in, muted);
+}
+
 static inline uint64_t uint64_diff(uint64_t ts1, uint64_t ts2)
 {
 	return (ts1 < ts2) ?  (ts2 - ts1) : (ts1 - ts2);
@@ -1394,6 +1539,93 @@ static inline void obs_source_main_render(obs_source_t *source)
 
 static bool ready_async_frame(obs_source_t *source, uint64_t sys_time);
 
+static inline void render_video(obs_source_t *source)
+{
+	if (source->filters.num && !source->rendering_filter)
+		obs_source_render_filters(source);
+
+	else if (source->info.video_render)
+		obs_source_main_render(source);
+
+	else if (source->filter_target)
+		obs_source_video_render(source->filter_target);
+
+	else
+		obs_source_render_async_video(source);
+}
+
+static inline bool use_render_cache(const obs_source_t *source)
+{
+	/* the filter chain renders back into the source itself, that part
+	 * is always rendered directly */
+	return (source->flags & OBS_SOURCE_FLAG_CACHE_RENDER) != 0 &&
+		!source->rendering_filter &&
+		source->info.type != OBS_SOURCE_TYPE_FILTER;
+}
+
+/*
+ * The first time the source is drawn in a frame its output (filters
+ * included) is rendered to the cache texture, every draw of the source in
+ * that frame then just draws the texture.  The cache is rendered with
+ * premultiplied alpha and drawn back with a premultiplied blend, which gives
+ * the same result as drawing the source directly.
+ */
+static bool render_cached(obs_source_t *source)
+{
+	uint32_t cx = obs_source_get_width(source);
+	uint32_t cy = obs_source_get_height(source);
+	gs_effect_t *effect = obs->video.default_effect;
+	gs_technique_t *tech;
+	gs_texture_t *tex;
+	size_t passes, i;
+
+	if (!cx || !cy)
+		return false;
+
+	if (!source->render_cache) {
+		source->render_cache = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		if (!source->render_cache)
+			return false;
+	}
+
+	gs_blend_state_push();
+
+	if (gs_texrender_begin(source->render_cache, cx, cy)) {
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		gs_blend_function_separate(
+				GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
+				GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+		render_video(source);
+
+		gs_texrender_end(source->render_cache);
+	}
+
+	tex = gs_texrender_get_texture(source->render_cache);
+	if (tex) {
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+		tech = gs_effect_get_technique(effect, "Draw");
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect,
+					"image"), tex);
+
+		passes = gs_technique_begin(tech);
+		for (i = 0; i < passes; i++) {
+			gs_technique_begin_pass(tech, i);
+			gs_draw_sprite(tex, 0, cx, cy);
+			gs_technique_end_pass(tech);
+		}
+		gs_technique_end(tech);
+	}
+
+	gs_blend_state_pop();
+	return true;
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!source) return;
@@ -1407,17 +1639,10 @@ void obs_source_video_render(obs_source_t *source)
 		return;
 	}
 
-	if (source->filters.num && !source->rendering_filter)
-		obs_source_render_filters(source);
-
-	else if (source->info.video_render)
-		obs_source_main_render(source);
-
-	else if (source->filter_target)
-		obs_source_video_render(source->filter_target);
+	if (use_render_cache(source) && render_cached(source))
+		return;
 
-	else
-		obs_source_render_async_video(source);
+	render_video(source);
 }
 
 static uint32_t get_base_width(const obs_source_t *source)
@@ -1809,33 +2034,45 @@ static inline bool async_texture_changed(struct obs_source *source,
 
 static inline void free_async_cache(struct obs_source *source)
 {
+	release_owned_frames(source);
+
 	for (size_t i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
 
 	da_resize(source->async_cache, 0);
-	da_resize(source->async_frames, 0);
+	async_queue_clear(&source->async_frames);
 	source->cur_async_frame = NULL;
 }
 
 #define MAX_UNUSED_FRAME_DURATION 5
 
-/* frees frame allocations if they haven't been used for a specific period
- * of time */
+/* gives frames back to the frame pool if they haven't been used for a
+ * specific period of time */
 static void clean_cache(obs_source_t *source)
 {
 	for (size_t i = source->async_cache.num; i > 0; i--) {
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
-				da_erase(source->async_cache, i - 1);
+				struct async_frame *last = da_end(
+						source->async_cache);
+
+				obs_frame_pool_release(&obs->data.frame_pool,
+						af->frame);
+
+				/* the cache is unordered, move the last slot
+				 * into the hole instead of shifting */
+				if (af != last) {
+					*af = *last;
+					get_async_source_frame(af->frame)
+						->cache_idx = i - 1;
+				}
+				da_pop_back(source->async_cache);
 			}
 		}
 	}
 }
 
-#define MAX_ASYNC_FRAMES 30
-
 static inline struct obs_source_frame *cache_video(struct obs_source *source,
 		const struct obs_source_frame *frame)
 {
@@ -1872,8 +2109,10 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(frame->format,
-				frame->width, frame->height);
+		new_frame = obs_frame_pool_get(&obs->data.frame_pool,
+				frame->format, frame->width, frame->height);
+		get_async_source_frame(new_frame)->cache_idx =
+			source->async_cache.num;
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
@@ -1889,7 +2128,7 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	copy_frame_data(new_frame, frame);
 
 	if (os_atomic_dec_long(&new_frame->refs) == 0) {
-		obs_source_frame_destroy(new_frame);
+		obs_frame_pool_release(&obs->data.frame_pool, new_frame);
 		new_frame = NULL;
 	}
 
@@ -1914,12 +2153,92 @@ void obs_source_output_video(obs_source_t *source,
 
 	if (output) {
 		pthread_mutex_lock(&source->async_mutex);
-		da_push_back(source->async_frames, &output);
+		if (!async_queue_push(&source->async_frames, output))
+			remove_async_frame(source, output);
 		pthread_mutex_unlock(&source->async_mutex);
 		source->async_active = true;
 	}
 }
 
+/* planar formats are uploaded to the GPU as a single block, so they can only
+ * be used in place if the planes are laid out the way libobs allocates them */
+static bool frame_data_usable(const struct obs_source_frame *frame)
+{
+	size_t luma = (size_t)frame->width * frame->height;
+
+	switch (get_convert_type(frame->format)) {
+	case CONVERT_420:
+		return frame->linesize[0] == frame->width &&
+		       frame->linesize[1] == frame->width / 2 &&
+		       frame->linesize[2] == frame->width / 2 &&
+		       frame->data[1] == frame->data[0] + luma &&
+		       frame->data[2] == frame->data[1] + luma / 4;
+
+	case CONVERT_NV12:
+		return frame->linesize[0] == frame->width &&
+		       frame->linesize[1] == frame->width &&
+		       frame->data[1] == frame->data[0] + luma;
+
+	case CONVERT_422_Y:
+	case CONVERT_422_U:
+	case CONVERT_NONE:
+		break;
+	}
+
+	return true;
+}
+
+void obs_source_output_video_owned(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		obs_source_frame_release_t release, void *param)
+{
+	struct async_source_frame *owned;
+
+	if (!source || !frame) {
+		if (release)
+			release(param);
+		if (source)
+			source->async_active = false;
+		return;
+	}
+
+	if (!release || !frame_data_usable(frame)) {
+		obs_source_output_video(source, frame);
+		if (release)
+			release(param);
+		return;
+	}
+
+	owned = bzalloc(sizeof(struct async_source_frame));
+	owned->frame      = *frame;
+	owned->frame.refs = 1;
+	owned->release    = release;
+	owned->param      = param;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
+		free_async_cache(source);
+		source->last_frame_ts = 0;
+		pthread_mutex_unlock(&source->async_mutex);
+
+		free_async_frame(&owned->frame);
+		return;
+	}
+
+	if (async_texture_changed(source, frame)) {
+		free_async_cache(source);
+		source->async_cache_width  = frame->width;
+		source->async_cache_height = frame->height;
+		source->async_cache_format = frame->format;
+	}
+
+	async_queue_push(&source->async_frames, &owned->frame);
+	pthread_mutex_unlock(&source->async_mutex);
+
+	source->async_active = true;
+}
+
 static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
 		struct obs_audio_data *in)
 {
@@ -1941,8 +2260,7 @@ static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
 	return in;
 }
 
-static inline void reset_resampler(obs_source_t *source,
-		const struct obs_source_audio *audio)
+static inline void create_resampler(obs_source_t *source)
 {
 	const struct audio_output_info *obs_info;
 	struct resample_info output_info;
@@ -1953,12 +2271,42 @@ static inline void reset_resampler(obs_source_t *source,
 	output_info.samples_per_sec  = obs_info->samples_per_sec;
 	output_info.speakers         = obs_info->speakers;
 
+	source->resampler = audio_resampler_create(&output_info,
+			&source->sample_info);
+
+	source->audio_failed = source->resampler == NULL;
+	if (source->resampler == NULL)
+		blog(LOG_ERROR, "creation of resampler failed");
+}
+
+static inline void reset_drift_compensation(obs_source_t *source,
+		uint64_t timestamp)
+{
+	source->drift_start_ts    = timestamp;
+	source->drift_next_update = 0;
+	source->drift_in_frames   = 0;
+	source->drift_out_frames  = 0;
+	source->drift_offset      = 0.0;
+
+	if (source->drift_ratio != 1.0 && source->resampler)
+		audio_resampler_set_compensation(source->resampler, 1.0);
+	source->drift_ratio = 1.0;
+}
+
+static inline void reset_resampler(obs_source_t *source,
+		const struct obs_source_audio *audio)
+{
+	const struct audio_output_info *obs_info;
+
+	obs_info = audio_output_get_info(obs->audio.audio);
+
 	source->sample_info.format          = audio->format;
 	source->sample_info.samples_per_sec = audio->samples_per_sec;
 	source->sample_info.speakers        = audio->speakers;
 
 	audio_resampler_destroy(source->resampler);
 	source->resampler = NULL;
+	reset_drift_compensation(source, 0);
 
 	if (source->sample_info.samples_per_sec == obs_info->samples_per_sec &&
 	    source->sample_info.format          == obs_info->format          &&
@@ -1967,12 +2315,88 @@ static inline void reset_resampler(obs_source_t *source,
 		return;
 	}
 
-	source->resampler = audio_resampler_create(&output_info,
-			&source->sample_info);
+	create_resampler(source);
+}
 
-	source->audio_failed = source->resampler == NULL;
-	if (source->resampler == NULL)
-		blog(LOG_ERROR, "creation of resampler failed");
+/* how long to measure before compensating, how long to measure before
+ * starting a new measurement, how often to update, how long to take to
+ * correct any offset that has built up, and the maximum stretch */
+#define DRIFT_MIN_TIME         10000000000ULL
+#define DRIFT_WINDOW_TIME     600000000000ULL
+#define DRIFT_UPDATE_INTERVAL   1000000000ULL
+#define DRIFT_CORRECTION_TIME  30000000000.0
+#define DRIFT_MAX_RATIO        0.005
+#define DRIFT_MIN_RATIO        0.00002
+
+/* capture devices run on their own clock, which drifts against the system
+ * clock that their timestamps (and everything else) use.  rather than let
+ * the difference build up until the timestamps have to be reset, the drift
+ * is measured over time and the resampler is adjusted to absorb it */
+static void update_drift_compensation(obs_source_t *source,
+		const struct obs_source_audio *audio)
+{
+	uint64_t ts = audio->timestamp;
+	uint32_t out_rate = audio_output_get_sample_rate(obs->audio.audio);
+	double elapsed_ts, elapsed_in, elapsed_out, clock_ratio, ratio;
+
+	if (!source->drift_start_ts || ts < source->drift_start_ts) {
+		reset_drift_compensation(source, ts);
+		return;
+	}
+
+	elapsed_ts = (double)(ts - source->drift_start_ts);
+	elapsed_in = (double)source->drift_in_frames * 1000000000.0 /
+		(double)audio->samples_per_sec;
+
+	/* discontinuity, start measuring again */
+	if (fabs(elapsed_ts - elapsed_in * source->drift_ratio) >
+			(double)MAX_TS_VAR) {
+		reset_drift_compensation(source, ts);
+		return;
+	}
+
+	/* start a new measurement every so often (keeping the current ratio)
+	 * so that changes in drift are followed */
+	if (elapsed_in >= (double)DRIFT_WINDOW_TIME) {
+		source->drift_start_ts    = ts;
+		source->drift_next_update = 0;
+		source->drift_in_frames   = 0;
+		source->drift_out_frames  = 0;
+		return;
+	}
+
+	if (elapsed_in < (double)DRIFT_MIN_TIME ||
+	    ts < source->drift_next_update)
+		return;
+
+	source->drift_next_update = ts + DRIFT_UPDATE_INTERVAL;
+
+	elapsed_out = (double)source->drift_out_frames * 1000000000.0 /
+		(double)out_rate;
+	clock_ratio = elapsed_ts / elapsed_in;
+
+	source->drift_offset = source->drift_offset * 0.9 +
+		(elapsed_ts - elapsed_out) * 0.1;
+
+	ratio = clock_ratio + source->drift_offset / DRIFT_CORRECTION_TIME;
+	if (ratio > 1.0 + DRIFT_MAX_RATIO)
+		ratio = 1.0 + DRIFT_MAX_RATIO;
+	else if (ratio < 1.0 - DRIFT_MAX_RATIO)
+		ratio = 1.0 - DRIFT_MAX_RATIO;
+
+	/* sources whose timestamps come from their sample count have nothing
+	 * to compensate for */
+	if (source->drift_ratio == 1.0 && fabs(ratio - 1.0) < DRIFT_MIN_RATIO)
+		return;
+
+	if (!source->resampler) {
+		create_resampler(source);
+		if (!source->resampler)
+			return;
+	}
+
+	if (audio_resampler_set_compensation(source->resampler, ratio))
+		source->drift_ratio = ratio;
 }
 
 static void copy_audio_data(obs_source_t *source,
@@ -2036,6 +2460,10 @@ static void process_audio(obs_source_t *source,
 	if (source->audio_failed)
 		return;
 
+	update_drift_compensation(source, audio);
+	if (source->audio_failed)
+		return;
+
 	if (source->resampler) {
 		uint8_t  *output[MAX_AV_PLANES];
 		uint64_t offset;
@@ -2053,6 +2481,9 @@ static void process_audio(obs_source_t *source,
 				audio->timestamp);
 	}
 
+	source->drift_in_frames  += audio->frames;
+	source->drift_out_frames += frames;
+
 	mono_output = audio_output_get_channels(obs->audio.audio) == 1;
 
 	if (!mono_output && (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0)
@@ -2100,31 +2531,43 @@ static inline bool frame_out_of_bounds(const obs_source_t *source, uint64_t ts)
 static void remove_async_frame(obs_source_t *source,
 		struct obs_source_frame *frame)
 {
-	for (size_t i = 0; i < source->async_cache.num; i++) {
-		struct async_frame *f = &source->async_cache.array[i];
+	struct async_source_frame *af;
+	struct async_frame *f;
 
-		if (f->frame == frame) {
-			f->used = false;
-			break;
-		}
+	if (!frame)
+		return;
+
+	af = get_async_source_frame(frame);
+	if (af->release) {
+		obs_source_frame_decref(frame);
+		return;
 	}
+
+	/* the frame may have left the cache (and been reused elsewhere)
+	 * since its index was set, so verify the slot still holds it */
+	if (af->cache_idx >= source->async_cache.num)
+		return;
+
+	f = source->async_cache.array + af->cache_idx;
+	if (f->frame == frame)
+		f->used = false;
 }
 
 /* #define DEBUG_ASYNC_FRAMES 1 */
 
 static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 {
-	struct obs_source_frame *next_frame = source->async_frames.array[0];
+	struct async_frame_queue *queue     = &source->async_frames;
+	struct obs_source_frame *next_frame = async_queue_peek(queue, 0);
 	struct obs_source_frame *frame      = NULL;
 	uint64_t sys_offset = sys_time - source->last_sys_timestamp;
 	uint64_t frame_time = next_frame->timestamp;
 	uint64_t frame_offset = 0;
 
 	if ((source->flags & OBS_SOURCE_FLAG_UNBUFFERED) != 0) {
-		while (source->async_frames.num > 1) {
-			da_erase(source->async_frames, 0);
-			remove_async_frame(source, next_frame);
-			next_frame = source->async_frames.array[0];
+		while (queue->num > 1) {
+			remove_async_frame(source, async_queue_pop(queue));
+			next_frame = async_queue_peek(queue, 0);
 		}
 
 		return true;
@@ -2136,7 +2579,7 @@ static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 			"number of frames: %lu",
 			source->last_frame_ts, frame_time, sys_offset,
 			frame_time - source->last_frame_ts,
-			(unsigned long)source->async_frames.num);
+			(unsigned long)queue->num);
 #endif
 
 	/* account for timestamp invalidation */
@@ -2161,7 +2604,7 @@ static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 			break;
 
 		if (frame)
-			da_erase(source->async_frames, 0);
+			async_queue_pop(queue);
 
 #if DEBUG_ASYNC_FRAMES
 		blog(LOG_DEBUG, "new frame, "
@@ -2173,11 +2616,11 @@ static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 
 		remove_async_frame(source, frame);
 
-		if (source->async_frames.num == 1)
+		if (queue->num == 1)
 			return true;
 
 		frame = next_frame;
-		next_frame = source->async_frames.array[1];
+		next_frame = async_queue_peek(queue, 1);
 
 		/* more timestamp checking and compensating */
 		if ((next_frame->timestamp - frame_time) > MAX_TS_VAR) {
@@ -2207,8 +2650,8 @@ static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
 		return NULL;
 
 	if (!source->last_frame_ts || ready_async_frame(source, sys_time)) {
-		struct obs_source_frame *frame = source->async_frames.array[0];
-		da_erase(source->async_frames, 0);
+		struct obs_source_frame *frame =
+			async_queue_pop(&source->async_frames);
 
 		if (!source->last_frame_ts)
 			source->last_frame_ts = frame->timestamp;
@@ -2253,12 +2696,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		free_async_frame(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			free_async_frame(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -2709,6 +3152,67 @@ uint32_t obs_source_get_audio_mixers(const obs_source_t *source)
 	return audio_line_get_mixers(source->audio_line);
 }
 
+/* called with audio_cb_mutex held */
+static size_t find_audio_cb(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param)
+{
+	for (size_t i = 0; i < source->audio_cb_list.num; i++) {
+		struct audio_cb_info *info = source->audio_cb_list.array + i;
+
+		if (info->callback == callback && info->param == param)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+void obs_source_add_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param)
+{
+	struct audio_cb_info info = {callback, param, false};
+	size_t idx;
+
+	if (!source || !callback)
+		return;
+
+	pthread_mutex_lock(&source->audio_cb_mutex);
+
+	idx = find_audio_cb(source, callback, param);
+	if (idx == DARRAY_INVALID) {
+		da_push_back(source->audio_cb_list, &info);
+		os_atomic_inc_long(&source->audio_cb_count);
+
+	} else if (source->audio_cb_list.array[idx].remove) {
+		source->audio_cb_list.array[idx].remove = false;
+		os_atomic_inc_long(&source->audio_cb_count);
+	}
+
+	pthread_mutex_unlock(&source->audio_cb_mutex);
+}
+
+void obs_source_remove_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param)
+{
+	size_t idx;
+
+	if (!source)
+		return;
+
+	pthread_mutex_lock(&source->audio_cb_mutex);
+
+	idx = find_audio_cb(source, callback, param);
+	if (idx != DARRAY_INVALID && !source->audio_cb_list.array[idx].remove) {
+		if (source->audio_cb_signalling)
+			source->audio_cb_list.array[idx].remove = true;
+		else
+			da_erase(source->audio_cb_list, idx);
+
+		os_atomic_dec_long(&source->audio_cb_count);
+	}
+
+	pthread_mutex_unlock(&source->audio_cb_mutex);
+}
+
 void obs_source_draw_set_color_matrix(const struct matrix4 *color_matrix,
 		const struct vec3 *color_range_min,
 		const struct vec3 *color_range_max)
@@ -128,14 +128,6 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
-static inline void unmap_last_surface(struct obs_core_video *video)
-{
-	if (video->mapped_surface) {
-		gs_stagesurface_unmap(video->mapped_surface);
-		video->mapped_surface = NULL;
-	}
-}
-
 static inline void render_main_texture(struct obs_core_video *video,
 		int cur_texture)
 {
@@ -152,13 +144,15 @@ static inline void render_main_texture(struct obs_core_video *video,
 }
 
 static inline gs_effect_t *get_scale_effect_internal(
-		struct obs_core_video *video)
+		struct obs_core_video *video,
+		uint32_t src_width, uint32_t src_height,
+		uint32_t width, uint32_t height)
 {
 	/* if the dimension is under half the size of the original image,
 	 * bicubic/lanczos can't sample enough pixels to create an accurate
 	 * image, so use the bilinear low resolution effect instead */
-	if (video->output_width  < (video->base_width  / 2) &&
-	    video->output_height < (video->base_height / 2)) {
+	if (width  < (src_width  / 2) &&
+	    height < (src_height / 2)) {
 		return video->bilinear_lowres_effect;
 	}
 
@@ -171,24 +165,26 @@ static inline gs_effect_t *get_scale_effect_internal(
 	return video->bicubic_effect;
 }
 
-static inline bool resolution_close(struct obs_core_video *video,
+static inline bool resolution_close(uint32_t src_width, uint32_t src_height,
 		uint32_t width, uint32_t height)
 {
-	long width_cmp  = (long)video->base_width  - (long)width;
-	long height_cmp = (long)video->base_height - (long)height;
+	long width_cmp  = (long)src_width  - (long)width;
+	long height_cmp = (long)src_height - (long)height;
 
 	return labs(width_cmp) <= 16 && labs(height_cmp) <= 16;
 }
 
 static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
+		uint32_t src_width, uint32_t src_height,
 		uint32_t width, uint32_t height)
 {
-	if (resolution_close(video, width, height)) {
+	if (resolution_close(src_width, src_height, width, height)) {
 		return video->default_effect;
 	} else {
 		/* if the scale method couldn't be loaded, use either bicubic
 		 * or bilinear by default */
-		gs_effect_t *effect = get_scale_effect_internal(video);
+		gs_effect_t *effect = get_scale_effect_internal(video,
+				src_width, src_height, width, height);
 		if (!effect)
 			effect = !!video->bicubic_effect ?
 				video->bicubic_effect :
@@ -197,21 +193,25 @@ static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
 	}
 }
 
-static inline void render_output_texture(struct obs_core_video *video,
-		int cur_texture, int prev_texture)
+/* scales texture in to target, converting it with the output color matrix if
+ * it hasn't been already */
+static void render_scaled_texture(struct obs_core_video *video,
+		gs_texture_t *texture, gs_texture_t *target, bool use_matrix)
 {
-	gs_texture_t *texture = video->render_textures[prev_texture];
-	gs_texture_t *target  = video->output_textures[cur_texture];
+	uint32_t     src_width  = gs_texture_get_width(texture);
+	uint32_t     src_height = gs_texture_get_height(texture);
 	uint32_t     width   = gs_texture_get_width(target);
 	uint32_t     height  = gs_texture_get_height(target);
 	struct vec2  base_i;
 
 	vec2_set(&base_i,
-		1.0f / (float)video->base_width,
-		1.0f / (float)video->base_height);
+		1.0f / (float)src_width,
+		1.0f / (float)src_height);
 
-	gs_effect_t    *effect  = get_scale_effect(video, width, height);
-	gs_technique_t *tech    = gs_effect_get_technique(effect, "DrawMatrix");
+	gs_effect_t    *effect  = get_scale_effect(video, src_width, src_height,
+			width, height);
+	gs_technique_t *tech    = gs_effect_get_technique(effect,
+			use_matrix ? "DrawMatrix" : "Draw");
 	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
 	gs_eparam_t    *matrix  = gs_effect_get_param_by_name(effect,
 			"color_matrix");
@@ -219,16 +219,15 @@ static inline void render_output_texture(struct obs_core_video *video,
 			"base_dimension_i");
 	size_t      passes, i;
 
-	if (!video->textures_rendered[prev_texture])
-		return;
-
 	gs_set_render_target(target, NULL);
 	set_render_size(width, height);
 
 	if (bres_i)
 		gs_effect_set_vec2(bres_i, &base_i);
 
-	gs_effect_set_val(matrix, video->color_matrix, sizeof(float) * 16);
+	if (use_matrix)
+		gs_effect_set_val(matrix, video->color_matrix,
+				sizeof(float) * 16);
 	gs_effect_set_texture(image, texture);
 
 	gs_enable_blending(false);
@@ -240,6 +239,16 @@ static inline void render_output_texture(struct obs_core_video *video,
 	}
 	gs_technique_end(tech);
 	gs_enable_blending(true);
+}
+
+static inline void render_output_texture(struct obs_core_video *video,
+		int cur_texture, int prev_texture)
+{
+	if (!video->textures_rendered[prev_texture])
+		return;
+
+	render_scaled_texture(video, video->render_textures[prev_texture],
+			video->output_textures[cur_texture], true);
 
 	video->textures_output[cur_texture] = true;
 }
@@ -250,25 +259,21 @@ static inline void set_eparam(gs_effect_t *effect, const char *name, float val)
 	gs_effect_set_float(param, val);
 }
 
-static void render_convert_texture(struct obs_core_video *video,
-		int cur_texture, int prev_texture)
+static void render_conversion(struct obs_core_video *video,
+		const struct obs_conversion_layout *layout,
+		gs_texture_t *texture, gs_texture_t *target)
 {
-	gs_texture_t *texture = video->output_textures[prev_texture];
-	gs_texture_t *target  = video->convert_textures[cur_texture];
-	float        fwidth  = (float)video->output_width;
-	float        fheight = (float)video->output_height;
+	float        fwidth  = (float)layout->width;
+	float        fheight = (float)layout->height;
 	size_t       passes, i;
 
 	gs_effect_t    *effect  = video->conversion_effect;
 	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
 	gs_technique_t *tech    = gs_effect_get_technique(effect,
-			video->conversion_tech);
+			layout->tech);
 
-	if (!video->textures_output[prev_texture])
-		return;
-
-	set_eparam(effect, "u_plane_offset", (float)video->plane_offsets[1]);
-	set_eparam(effect, "v_plane_offset", (float)video->plane_offsets[2]);
+	set_eparam(effect, "u_plane_offset", (float)layout->plane_offsets[1]);
+	set_eparam(effect, "v_plane_offset", (float)layout->plane_offsets[2]);
 	set_eparam(effect, "width",  fwidth);
 	set_eparam(effect, "height", fheight);
 	set_eparam(effect, "width_i",  1.0f / fwidth);
@@ -277,23 +282,34 @@ static void render_convert_texture(struct obs_core_video *video,
 	set_eparam(effect, "height_d2", fheight * 0.5f);
 	set_eparam(effect, "width_d2_i",  1.0f / (fwidth  * 0.5f));
 	set_eparam(effect, "height_d2_i", 1.0f / (fheight * 0.5f));
-	set_eparam(effect, "input_height", (float)video->conversion_height);
+	set_eparam(effect, "input_height", (float)layout->conversion_height);
 
 	gs_effect_set_texture(image, texture);
 
 	gs_set_render_target(target, NULL);
-	set_render_size(video->output_width, video->conversion_height);
+	set_render_size(layout->width, layout->conversion_height);
 
 	gs_enable_blending(false);
 	passes = gs_technique_begin(tech);
 	for (i = 0; i < passes; i++) {
 		gs_technique_begin_pass(tech, i);
-		gs_draw_sprite(texture, 0, video->output_width,
-				video->conversion_height);
+		gs_draw_sprite(texture, 0, layout->width,
+				layout->conversion_height);
 		gs_technique_end_pass(tech);
 	}
 	gs_technique_end(tech);
 	gs_enable_blending(true);
+}
+
+static void render_convert_texture(struct obs_core_video *video,
+		int cur_texture, int prev_texture)
+{
+	if (!video->textures_output[prev_texture])
+		return;
+
+	render_conversion(video, &video->conversion,
+			video->output_textures[prev_texture],
+			video->convert_textures[cur_texture]);
 
 	video->textures_converted[cur_texture] = true;
 }
@@ -313,8 +329,6 @@ static inline void stage_output_texture(struct obs_core_video *video,
 		texture_ready = video->output_textures[prev_texture];
 	}
 
-	unmap_last_surface(video);
-
 	if (!texture_ready)
 		return;
 
@@ -323,6 +337,67 @@ static inline void stage_output_texture(struct obs_core_video *video,
 	video->textures_copied[cur_texture] = true;
 }
 
+static inline void stage_rendition_texture(struct obs_core_video *video,
+		struct obs_rendition *r, int cur_texture, int prev_texture)
+{
+	gs_texture_t *texture;
+	bool         texture_ready;
+
+	if (video->gpu_conversion) {
+		texture = r->convert_textures[prev_texture];
+		texture_ready = r->textures_converted[prev_texture];
+	} else {
+		texture = r->output_textures[prev_texture];
+		texture_ready = r->textures_output[prev_texture];
+	}
+
+	/* if the surface is still with the copy thread, the frame is lost */
+	r->textures_copied[cur_texture] = false;
+
+	if (!texture_ready || r->surfaces_out[cur_texture])
+		return;
+
+	gs_stage_texture(r->copy_surfaces[cur_texture], texture);
+	r->textures_copied[cur_texture] = true;
+}
+
+/* renditions are sorted largest first, and each one is scaled down from the
+ * one before it (or from the main render for the first) */
+static void render_renditions(struct obs_core_video *video,
+		int cur_texture, int prev_texture)
+{
+	gs_texture_t *source = video->render_textures[prev_texture];
+	bool         source_ready = video->textures_rendered[prev_texture];
+	bool         use_matrix = true;
+
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	for (size_t i = 0; i < video->renditions.num; i++) {
+		struct obs_rendition *r = video->renditions.array[i];
+		gs_texture_t *target = r->output_textures[cur_texture];
+
+		if (source_ready) {
+			render_scaled_texture(video, source, target,
+					use_matrix);
+			r->textures_output[cur_texture] = true;
+		}
+
+		if (video->gpu_conversion && r->textures_output[prev_texture]) {
+			render_conversion(video, &r->conversion,
+					r->output_textures[prev_texture],
+					r->convert_textures[cur_texture]);
+			r->textures_converted[cur_texture] = true;
+		}
+
+		stage_rendition_texture(video, r, cur_texture, prev_texture);
+
+		source     = target;
+		use_matrix = false;
+	}
+
+	pthread_mutex_unlock(&video->renditions_mutex);
+}
+
 static inline void render_video(struct obs_core_video *video, int cur_texture,
 		int prev_texture)
 {
@@ -337,6 +412,7 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 		render_convert_texture(video, cur_texture, prev_texture);
 
 	stage_output_texture(video, cur_texture, prev_texture);
+	render_renditions(video, cur_texture, prev_texture);
 
 	gs_set_render_target(NULL, NULL);
 	gs_enable_blending(true);
@@ -344,18 +420,196 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 	gs_end_scene();
 }
 
+struct obs_copy_frame {
+	struct video_data               data;
+	gs_stagesurf_t                  *surface;
+	int                             count;
+
+	/* set for rendition frames, which are staged in the rendition's own
+	 * copy ring rather than swapped out with spares */
+	struct obs_rendition            *rendition;
+	int                             slot;
+};
+
+/* called once the copy thread or video-io is done with a mapped surface */
+static void return_lent_surface(void *param)
+{
+	struct obs_core_video *video = &obs->video;
+	gs_stagesurf_t *surface = param;
+
+	pthread_mutex_lock(&video->lent_surfaces_mutex);
+	da_push_back(video->returned_surfaces, &surface);
+	video->num_lent_surfaces--;
+	pthread_mutex_unlock(&video->lent_surfaces_mutex);
+
+	if (video->offline)
+		os_event_signal(video->surface_returned);
+}
+
+static void return_rendition_surface(struct obs_rendition *r, int slot)
+{
+	struct obs_core_video *video = &obs->video;
+
+	pthread_mutex_lock(&video->lent_surfaces_mutex);
+	r->surfaces_returned[slot] = true;
+	pthread_mutex_unlock(&video->lent_surfaces_mutex);
+}
+
+static inline void return_copy_frame(struct obs_copy_frame *frame)
+{
+	if (frame->rendition)
+		return_rendition_surface(frame->rendition, frame->slot);
+	else
+		return_lent_surface(frame->surface);
+}
+
+/* in offline mode frames are never dropped, so wait for the copy thread to
+ * hand back a surface if too many are out */
+static inline void wait_for_surface(struct obs_core_video *video)
+{
+	for (;;) {
+		bool available;
+
+		pthread_mutex_lock(&video->lent_surfaces_mutex);
+		available = video->spare_surfaces.num ||
+			video->returned_surfaces.num ||
+			video->num_lent_surfaces < MAX_LENT_SURFACES;
+		pthread_mutex_unlock(&video->lent_surfaces_mutex);
+
+		if (available || video_output_stopped(video->video))
+			break;
+
+		os_event_wait(video->surface_returned);
+	}
+}
+
+/* unmaps surfaces that have been handed back, and makes sure there's a spare
+ * surface to swap in to the copy ring the next time one is handed off */
+static inline void reclaim_lent_surfaces(struct obs_core_video *video)
+{
+	uint32_t height = video->gpu_conversion ?
+		video->conversion.conversion_height : video->output_height;
+	size_t num_lent;
+
+	pthread_mutex_lock(&video->lent_surfaces_mutex);
+	for (size_t i = 0; i < video->returned_surfaces.num; i++) {
+		gs_stagesurf_t *surface = video->returned_surfaces.array[i];
+
+		gs_stagesurface_unmap(surface);
+		da_push_back(video->spare_surfaces, &surface);
+	}
+	da_resize(video->returned_surfaces, 0);
+	num_lent = video->num_lent_surfaces;
+	pthread_mutex_unlock(&video->lent_surfaces_mutex);
+
+	if (!video->spare_surfaces.num && num_lent < MAX_LENT_SURFACES) {
+		gs_stagesurf_t *surface = gs_stagesurface_create(
+				video->output_width, height, GS_RGBA);
+		if (surface)
+			da_push_back(video->spare_surfaces, &surface);
+	}
+}
+
+/* unmaps rendition surfaces handed back by the copy thread, and frees
+ * renditions that were removed once none of their surfaces are out */
+static inline void reclaim_rendition_surfaces(struct obs_core_video *video)
+{
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	for (size_t i = video->renditions.num; i > 0; i--) {
+		struct obs_rendition *r = video->renditions.array[i - 1];
+		bool surfaces_out = false;
+
+		pthread_mutex_lock(&video->lent_surfaces_mutex);
+		for (size_t j = 0; j < MAX_TEXTURES; j++) {
+			if (r->surfaces_returned[j]) {
+				gs_stagesurface_unmap(r->copy_surfaces[j]);
+				r->surfaces_returned[j] = false;
+				r->surfaces_out[j]      = false;
+			}
+
+			if (r->surfaces_out[j])
+				surfaces_out = true;
+		}
+		pthread_mutex_unlock(&video->lent_surfaces_mutex);
+
+		if (r->removed && !surfaces_out) {
+			da_erase(video->renditions, i - 1);
+			obs_rendition_destroy(r);
+		}
+	}
+
+	pthread_mutex_unlock(&video->renditions_mutex);
+}
+
+static inline void queue_copy_frame(struct obs_core_video *video,
+		struct obs_copy_frame *frame)
+{
+	pthread_mutex_lock(&video->copy_mutex);
+	circlebuf_push_back(&video->copy_queue, frame, sizeof(*frame));
+	pthread_mutex_unlock(&video->copy_mutex);
+	os_sem_post(video->copy_sem);
+}
+
+/* renditions are staged in lockstep with the main output, so they're read
+ * back with the same frame timing */
+static inline void download_renditions(struct obs_core_video *video,
+		int read_texture, const struct obs_vframe_info *vframe_info)
+{
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	for (size_t i = 0; i < video->renditions.num; i++) {
+		struct obs_rendition *r = video->renditions.array[i];
+		gs_stagesurf_t *surface = r->copy_surfaces[read_texture];
+		struct obs_copy_frame frame;
+
+		if (r->removed || !r->textures_copied[read_texture])
+			continue;
+
+		memset(&frame, 0, sizeof(frame));
+
+		if (!gs_stagesurface_map(surface, &frame.data.data[0],
+					&frame.data.linesize[0]))
+			continue;
+
+		r->textures_copied[read_texture] = false;
+		r->surfaces_out[read_texture]    = true;
+
+		frame.data.timestamp = vframe_info->timestamp;
+		frame.count          = vframe_info->count;
+		frame.surface        = surface;
+		frame.rendition      = r;
+		frame.slot           = read_texture;
+		queue_copy_frame(video, &frame);
+	}
+
+	pthread_mutex_unlock(&video->renditions_mutex);
+}
+
+/* maps the surface and takes it out of the copy ring so it can be handed to
+ * the copy thread; it's unmapped when it comes back via return_lent_surface */
 static inline bool download_frame(struct obs_core_video *video,
-		int prev_texture, struct video_data *frame)
+		int read_texture, struct obs_copy_frame *frame)
 {
-	gs_stagesurf_t *surface = video->copy_surfaces[prev_texture];
+	gs_stagesurf_t *surface = video->copy_surfaces[read_texture];
 
-	if (!video->textures_copied[prev_texture])
+	/* too many surfaces out, the copy thread isn't keeping up */
+	if (!video->spare_surfaces.num)
 		return false;
 
-	if (!gs_stagesurface_map(surface, &frame->data[0], &frame->linesize[0]))
+	if (!gs_stagesurface_map(surface, &frame->data.data[0],
+				&frame->data.linesize[0]))
 		return false;
 
-	video->mapped_surface = surface;
+	video->copy_surfaces[read_texture] =
+		video->spare_surfaces.array[video->spare_surfaces.num - 1];
+	da_pop_back(video->spare_surfaces);
+
+	pthread_mutex_lock(&video->lent_surfaces_mutex);
+	video->num_lent_surfaces++;
+	pthread_mutex_unlock(&video->lent_surfaces_mutex);
+
+	frame->surface = surface;
 	return true;
 }
 
@@ -396,7 +650,8 @@ static inline uint32_t make_aligned_linesize_offset(uint32_t offset,
 	return (offset / dst_linesize) * src_linesize + remainder;
 }
 
-static void fix_gpu_converted_alignment(struct obs_core_video *video,
+static void fix_gpu_converted_alignment(
+		const struct obs_conversion_layout *layout,
 		struct video_frame *output, const struct video_data *input)
 {
 	uint32_t src_linesize = input->linesize[0];
@@ -404,61 +659,86 @@ static void fix_gpu_converted_alignment(struct obs_core_video *video,
 	uint32_t src_pos      = 0;
 
 	for (size_t i = 0; i < 3; i++) {
-		if (video->plane_linewidth[i] == 0)
+		if (layout->plane_linewidth[i] == 0)
 			break;
 
-		src_pos = make_aligned_linesize_offset(video->plane_offsets[i],
+		src_pos = make_aligned_linesize_offset(layout->plane_offsets[i],
 				dst_linesize, src_linesize);
 
 		copy_dealign(output->data[i], 0, dst_linesize,
 				input->data[0], src_pos, src_linesize,
-				video->plane_sizes[i]);
+				layout->plane_sizes[i]);
 	}
 }
 
-static void set_gpu_converted_data(struct obs_core_video *video,
+static inline void get_gpu_converted_planes(
+		const struct obs_conversion_layout *layout,
+		struct video_frame *frame, const struct video_data *input)
+{
+	memset(frame, 0, sizeof(*frame));
+
+	for (size_t i = 0; i < 3; i++) {
+		if (layout->plane_linewidth[i] == 0)
+			break;
+
+		frame->linesize[i] = layout->plane_linewidth[i];
+		frame->data[i] = input->data[0] + layout->plane_offsets[i];
+	}
+}
+
+static void set_gpu_converted_data(const struct obs_conversion_layout *layout,
 		struct video_frame *output, const struct video_data *input,
 		const struct video_output_info *info)
 {
-	if (input->linesize[0] == video->output_width*4) {
+	if (input->linesize[0] == layout->width*4) {
 		struct video_frame frame;
 
-		for (size_t i = 0; i < 3; i++) {
-			if (video->plane_linewidth[i] == 0)
-				break;
-
-			frame.linesize[i] = video->plane_linewidth[i];
-			frame.data[i] =
-				input->data[0] + video->plane_offsets[i];
-		}
-
+		get_gpu_converted_planes(layout, &frame, input);
 		video_frame_copy(output, &frame, info->format, info->height);
 
 	} else {
-		fix_gpu_converted_alignment(video, output, input);
+		fix_gpu_converted_alignment(layout, output, input);
 	}
 }
 
-static void convert_frame(
+/* hands the mapped surface directly to video-io instead of copying it in to
+ * the frame cache */
+static bool lend_gpu_converted_data(struct obs_core_video *video,
+		const struct obs_copy_frame *input)
+{
+	struct video_frame frame;
+
+	if (input->data.linesize[0] != video->conversion.width*4)
+		return false;
+
+	get_gpu_converted_planes(&video->conversion, &frame, &input->data);
+
+	video_output_unlock_frame_lent(video->video, &frame,
+			return_lent_surface, input->surface);
+	return true;
+}
+
+static void convert_frame_slice(
 		struct video_frame *output, const struct video_data *input,
-		const struct video_output_info *info)
+		const struct video_output_info *info,
+		uint32_t start_y, uint32_t end_y)
 {
 	if (info->format == VIDEO_FORMAT_I420) {
 		compress_uyvx_to_i420(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_NV12) {
 		compress_uyvx_to_nv12(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_I444) {
 		convert_uyvx_to_i444(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else {
@@ -466,6 +746,52 @@ static void convert_frame(
 	}
 }
 
+void *obs_convert_thread(void *param)
+{
+	struct obs_convert_thread      *ct    = param;
+	struct obs_core_video          *video = &obs->video;
+	const struct video_output_info *info;
+
+	os_set_thread_name("libobs: conversion thread");
+
+	info = video_output_get_info(video->video);
+
+	while (os_sem_wait(ct->start_sem) == 0) {
+		if (video->convert_stop)
+			break;
+
+		convert_frame_slice(&video->convert_output,
+				video->convert_input, info,
+				ct->start_y, ct->end_y);
+
+		os_sem_post(video->convert_done_sem);
+	}
+
+	return NULL;
+}
+
+static void convert_frame(struct obs_core_video *video,
+		struct video_frame *output, const struct video_data *input,
+		const struct video_output_info *info)
+{
+	if (!video->num_convert_threads) {
+		convert_frame_slice(output, input, info, 0, info->height);
+		return;
+	}
+
+	video->convert_output = *output;
+	video->convert_input  = input;
+
+	for (size_t i = 0; i < video->num_convert_threads; i++)
+		os_sem_post(video->convert_threads[i].start_sem);
+
+	convert_frame_slice(output, input, info, 0, video->convert_end_y);
+
+	/* all slices must be done before the frame is unlocked */
+	for (size_t i = 0; i < video->num_convert_threads; i++)
+		os_sem_wait(video->convert_done_sem);
+}
+
 static inline void copy_rgbx_frame(
 		struct video_frame *output, const struct video_data *input,
 		const struct video_output_info *info)
@@ -481,29 +807,93 @@ static inline void copy_rgbx_frame(
 }
 
 static inline void output_video_data(struct obs_core_video *video,
-		struct video_data *input_frame, int count)
+		struct obs_copy_frame *input)
 {
 	const struct video_output_info *info;
+	struct video_data *input_frame = &input->data;
 	struct video_frame output_frame;
 	bool locked;
 
 	info = video_output_get_info(video->video);
 
-	locked = video_output_lock_frame(video->video, &output_frame, count,
-			input_frame->timestamp);
-	if (locked) {
-		if (video->gpu_conversion) {
-			set_gpu_converted_data(video, &output_frame,
-					input_frame, info);
+	locked = video_output_lock_frame(video->video, &output_frame,
+			input->count, input_frame->timestamp);
+	if (!locked) {
+		return_lent_surface(input->surface);
+		return;
+	}
 
-		} else if (format_is_yuv(info->format)) {
-			convert_frame(&output_frame, input_frame, info);
-		} else {
-			copy_rgbx_frame(&output_frame, input_frame, info);
-		}
+	if (video->gpu_conversion) {
+		if (lend_gpu_converted_data(video, input))
+			return;
+
+		set_gpu_converted_data(&video->conversion, &output_frame,
+				input_frame, info);
+
+	} else if (format_is_yuv(info->format)) {
+		convert_frame(video, &output_frame, input_frame, info);
+	} else {
+		copy_rgbx_frame(&output_frame, input_frame, info);
+	}
+
+	video_output_unlock_frame(video->video);
+	return_lent_surface(input->surface);
+}
+
+static inline void output_rendition_data(struct obs_core_video *video,
+		struct obs_copy_frame *input)
+{
+	struct obs_rendition *r = input->rendition;
+	const struct video_output_info *info;
+	struct video_frame output_frame;
+
+	info = video_output_get_info(r->video);
+
+	if (video_output_lock_frame(r->video, &output_frame, input->count,
+				input->data.timestamp)) {
+		if (video->gpu_conversion)
+			set_gpu_converted_data(&r->conversion, &output_frame,
+					&input->data, info);
+		else
+			copy_rgbx_frame(&output_frame, &input->data, info);
+
+		video_output_unlock_frame(r->video);
+	}
+
+	return_rendition_surface(r, input->slot);
+}
+
+void *obs_copy_thread(void *param)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_copy_frame frame;
+
+	os_set_thread_name("libobs: video copy thread");
+
+	while (os_sem_wait(video->copy_sem) == 0) {
+		if (video->copy_stop)
+			break;
+
+		pthread_mutex_lock(&video->copy_mutex);
+		circlebuf_pop_front(&video->copy_queue, &frame, sizeof(frame));
+		pthread_mutex_unlock(&video->copy_mutex);
+
+		if (frame.rendition)
+			output_rendition_data(video, &frame);
+		else
+			output_video_data(video, &frame);
+	}
 
-		video_output_unlock_frame(video->video);
+	/* give back anything that was still waiting to be output */
+	pthread_mutex_lock(&video->copy_mutex);
+	while (video->copy_queue.size) {
+		circlebuf_pop_front(&video->copy_queue, &frame, sizeof(frame));
+		return_copy_frame(&frame);
 	}
+	pthread_mutex_unlock(&video->copy_mutex);
+
+	UNUSED_PARAMETER(param);
+	return NULL;
 }
 
 static inline void video_sleep(struct obs_core_video *video,
@@ -514,7 +904,10 @@ static inline void video_sleep(struct obs_core_video *video,
 	uint64_t t = cur_time + interval_ns;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	if (video->offline) {
+		*p_time = t;
+		count = 1;
+	} else if (os_sleepto_ns(t)) {
 		*p_time = t;
 		count = 1;
 	} else {
@@ -531,32 +924,54 @@ static inline void video_sleep(struct obs_core_video *video,
 static inline void output_frame(uint64_t *cur_time, uint64_t interval)
 {
 	struct obs_core_video *video = &obs->video;
+	int num_textures = video->num_textures;
 	int cur_texture  = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
-	struct video_data frame;
-	bool frame_ready;
+	int prev_texture = cur_texture == 0 ? num_textures-1 : cur_texture-1;
 
-	memset(&frame, 0, sizeof(struct video_data));
+	/* read back the oldest staged surface, which was staged
+	 * num_textures-1 frames ago */
+	int read_texture = cur_texture == num_textures-1 ? 0 : cur_texture+1;
+	bool staged = video->textures_copied[read_texture];
+	struct obs_vframe_info vframe_info;
+	struct obs_copy_frame frame;
 
-	gs_enter_context(video->graphics);
-	render_video(video, cur_texture, prev_texture);
-	frame_ready = download_frame(video, prev_texture, &frame);
-	gs_flush();
-	gs_leave_context();
+	memset(&frame, 0, sizeof(frame));
 
-	if (frame_ready) {
-		struct obs_vframe_info vframe_info;
+	if (staged) {
 		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
 				sizeof(vframe_info));
 
-		frame.timestamp = vframe_info.timestamp;
-		output_video_data(video, &frame, vframe_info.count);
+		if (video->offline)
+			wait_for_surface(video);
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
+	gs_enter_context(video->graphics);
+	reclaim_lent_surfaces(video);
+	reclaim_rendition_surfaces(video);
+	render_video(video, cur_texture, prev_texture);
+
+	/* the copy/conversion in to video-io is done on the copy thread;
+	 * if the surface couldn't be handed off, the frame is dropped */
+	if (staged) {
+		if (download_frame(video, read_texture, &frame)) {
+			frame.data.timestamp = vframe_info.timestamp;
+			frame.count = vframe_info.count;
+			queue_copy_frame(video, &frame);
+		}
+
+		download_renditions(video, read_texture, &vframe_info);
+	}
+
+	gs_flush();
+	gs_leave_context();
+
+	if (++video->cur_texture == num_textures)
 		video->cur_texture = 0;
 
 	video_sleep(video, cur_time, interval);
+
+	/* offline audio is mixed up to the video clock */
+	audio_output_set_time(obs->audio.audio, *cur_time);
 }
 
 void *obs_video_thread(void *param)
@@ -573,6 +988,8 @@ void *obs_video_thread(void *param)
 
 		render_displays();
 
+		obs_volmeter_send_levels();
+
 		output_frame(&obs->video.video_time, interval);
 	}
 
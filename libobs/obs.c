@@ -52,6 +52,7 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->range   = ovi->range;
 	vi->colorspace = ovi->colorspace;
 	vi->cache_size = 6;
+	vi->offline = ovi->offline;
 }
 
 #define PIXEL_SIZE 4
@@ -59,113 +60,113 @@ static inline void make_video_info(struct video_output_info *vi,
 #define GET_ALIGN(val, align) \
 	(((val) + (align-1)) & ~(align-1))
 
-static inline void set_420p_sizes(const struct obs_video_info *ovi)
+static inline void set_420p_sizes(struct obs_conversion_layout *layout)
 {
-	struct obs_core_video *video = &obs->video;
+	uint32_t width  = layout->width;
+	uint32_t height = layout->height;
 	uint32_t chroma_pixels;
 	uint32_t total_bytes;
 
-	chroma_pixels = (ovi->output_width * ovi->output_height / 4);
+	chroma_pixels = (width * height / 4);
 	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
 
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = ovi->output_width * ovi->output_height;
-	video->plane_offsets[2] = video->plane_offsets[1] + chroma_pixels;
+	layout->plane_offsets[0] = 0;
+	layout->plane_offsets[1] = width * height;
+	layout->plane_offsets[2] = layout->plane_offsets[1] + chroma_pixels;
 
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width/2;
-	video->plane_linewidth[2] = ovi->output_width/2;
+	layout->plane_linewidth[0] = width;
+	layout->plane_linewidth[1] = width/2;
+	layout->plane_linewidth[2] = width/2;
 
-	video->plane_sizes[0] = video->plane_offsets[1];
-	video->plane_sizes[1] = video->plane_sizes[0]/4;
-	video->plane_sizes[2] = video->plane_sizes[1];
+	layout->plane_sizes[0] = layout->plane_offsets[1];
+	layout->plane_sizes[1] = layout->plane_sizes[0]/4;
+	layout->plane_sizes[2] = layout->plane_sizes[1];
 
-	total_bytes = video->plane_offsets[2] + chroma_pixels;
+	total_bytes = layout->plane_offsets[2] + chroma_pixels;
 
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
+	layout->conversion_height =
+		(total_bytes/PIXEL_SIZE + width-1) / width;
 
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "Planar420";
+	layout->conversion_height = GET_ALIGN(layout->conversion_height, 2);
+	layout->tech = "Planar420";
 }
 
-static inline void set_nv12_sizes(const struct obs_video_info *ovi)
+static inline void set_nv12_sizes(struct obs_conversion_layout *layout)
 {
-	struct obs_core_video *video = &obs->video;
+	uint32_t width  = layout->width;
+	uint32_t height = layout->height;
 	uint32_t chroma_pixels;
 	uint32_t total_bytes;
 
-	chroma_pixels = (ovi->output_width * ovi->output_height / 2);
+	chroma_pixels = (width * height / 2);
 	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
 
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = ovi->output_width * ovi->output_height;
+	layout->plane_offsets[0] = 0;
+	layout->plane_offsets[1] = width * height;
 
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width;
+	layout->plane_linewidth[0] = width;
+	layout->plane_linewidth[1] = width;
 
-	video->plane_sizes[0] = video->plane_offsets[1];
-	video->plane_sizes[1] = video->plane_sizes[0]/2;
+	layout->plane_sizes[0] = layout->plane_offsets[1];
+	layout->plane_sizes[1] = layout->plane_sizes[0]/2;
 
-	total_bytes = video->plane_offsets[1] + chroma_pixels;
+	total_bytes = layout->plane_offsets[1] + chroma_pixels;
 
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
+	layout->conversion_height =
+		(total_bytes/PIXEL_SIZE + width-1) / width;
 
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "NV12";
+	layout->conversion_height = GET_ALIGN(layout->conversion_height, 2);
+	layout->tech = "NV12";
 }
 
-static inline void set_444p_sizes(const struct obs_video_info *ovi)
+static inline void set_444p_sizes(struct obs_conversion_layout *layout)
 {
-	struct obs_core_video *video = &obs->video;
+	uint32_t width  = layout->width;
+	uint32_t height = layout->height;
 	uint32_t chroma_pixels;
 	uint32_t total_bytes;
 
-	chroma_pixels = (ovi->output_width * ovi->output_height);
+	chroma_pixels = (width * height);
 	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
 
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = chroma_pixels;
-	video->plane_offsets[2] = chroma_pixels + chroma_pixels;
+	layout->plane_offsets[0] = 0;
+	layout->plane_offsets[1] = chroma_pixels;
+	layout->plane_offsets[2] = chroma_pixels + chroma_pixels;
 
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width;
-	video->plane_linewidth[2] = ovi->output_width;
+	layout->plane_linewidth[0] = width;
+	layout->plane_linewidth[1] = width;
+	layout->plane_linewidth[2] = width;
 
-	video->plane_sizes[0] = chroma_pixels;
-	video->plane_sizes[1] = chroma_pixels;
-	video->plane_sizes[2] = chroma_pixels;
+	layout->plane_sizes[0] = chroma_pixels;
+	layout->plane_sizes[1] = chroma_pixels;
+	layout->plane_sizes[2] = chroma_pixels;
 
-	total_bytes = video->plane_offsets[2] + chroma_pixels;
+	total_bytes = layout->plane_offsets[2] + chroma_pixels;
 
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
+	layout->conversion_height =
+		(total_bytes/PIXEL_SIZE + width-1) / width;
 
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "Planar444";
+	layout->conversion_height = GET_ALIGN(layout->conversion_height, 2);
+	layout->tech = "Planar444";
 }
 
-static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
+/* conversion_height is left at 0 if the format can't be converted */
+static void calc_gpu_conversion_sizes(struct obs_conversion_layout *layout,
+		enum video_format format, uint32_t width, uint32_t height)
 {
-	obs->video.conversion_height = 0;
-	memset(obs->video.plane_offsets, 0, sizeof(obs->video.plane_offsets));
-	memset(obs->video.plane_sizes, 0, sizeof(obs->video.plane_sizes));
-	memset(obs->video.plane_linewidth, 0,
-		sizeof(obs->video.plane_linewidth));
+	memset(layout, 0, sizeof(*layout));
+	layout->width  = width;
+	layout->height = height;
 
-	switch ((uint32_t)ovi->output_format) {
+	switch ((uint32_t)format) {
 	case VIDEO_FORMAT_I420:
-		set_420p_sizes(ovi);
+		set_420p_sizes(layout);
 		break;
 	case VIDEO_FORMAT_NV12:
-		set_nv12_sizes(ovi);
+		set_nv12_sizes(layout);
 		break;
 	case VIDEO_FORMAT_I444:
-		set_444p_sizes(ovi);
+		set_444p_sizes(layout);
 		break;
 	}
 }
@@ -174,18 +175,20 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 
-	calc_gpu_conversion_sizes(ovi);
+	calc_gpu_conversion_sizes(&video->conversion, ovi->output_format,
+			ovi->output_width, ovi->output_height);
 
-	if (!video->conversion_height) {
+	if (!video->conversion.conversion_height) {
 		blog(LOG_INFO, "GPU conversion not available for format: %u",
 				(unsigned int)ovi->output_format);
 		video->gpu_conversion = false;
 		return true;
 	}
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+	for (size_t i = 0; i < (size_t)video->num_textures; i++) {
 		video->convert_textures[i] = gs_texture_create(
-				ovi->output_width, video->conversion_height,
+				ovi->output_width,
+				video->conversion.conversion_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
 
 		if (!video->convert_textures[i])
@@ -199,10 +202,10 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 	uint32_t output_height = video->gpu_conversion ?
-		video->conversion_height : ovi->output_height;
+		video->conversion.conversion_height : ovi->output_height;
 	size_t i;
 
-	for (i = 0; i < NUM_TEXTURES; i++) {
+	for (i = 0; i < (size_t)video->num_textures; i++) {
 		video->copy_surfaces[i] = gs_stagesurface_create(
 				ovi->output_width, output_height, GS_RGBA);
 
@@ -227,6 +230,82 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 	return true;
 }
 
+/* roughly how many output rows to give each CPU conversion thread */
+#define CONVERT_ROWS_PER_THREAD 540
+
+static bool obs_init_convert_threads(struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+	size_t   num_slices;
+	size_t   max_slices;
+	uint32_t rows;
+
+	if (video->gpu_conversion || !format_is_yuv(ovi->output_format))
+		return true;
+
+	num_slices = ovi->output_height / CONVERT_ROWS_PER_THREAD;
+	max_slices = (size_t)os_get_logical_cores() / 2;
+
+	if (num_slices > max_slices)
+		num_slices = max_slices;
+	if (num_slices > MAX_CONVERT_THREADS + 1)
+		num_slices = MAX_CONVERT_THREADS + 1;
+	if (num_slices < 2)
+		return true;
+
+	/* slices must start on even rows to keep 4:2:0 chroma intact */
+	rows = (ovi->output_height / (uint32_t)num_slices) & ~1;
+
+	video->convert_end_y = rows;
+
+	if (os_sem_init(&video->convert_done_sem, 0) != 0)
+		return false;
+
+	for (size_t i = 0; i < num_slices - 1; i++) {
+		struct obs_convert_thread *ct = &video->convert_threads[i];
+		bool last = i == num_slices - 2;
+
+		ct->start_y = rows * (uint32_t)(i + 1);
+		ct->end_y   = last ? ovi->output_height : ct->start_y + rows;
+
+		if (os_sem_init(&ct->start_sem, 0) != 0)
+			return false;
+		if (pthread_create(&ct->thread, NULL, obs_convert_thread,
+					ct) != 0) {
+			os_sem_destroy(ct->start_sem);
+			ct->start_sem = NULL;
+			return false;
+		}
+
+		video->num_convert_threads++;
+	}
+
+	blog(LOG_INFO, "Using %d threads for CPU color conversion",
+			(int)num_slices);
+	return true;
+}
+
+static void obs_free_convert_threads(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	video->convert_stop = true;
+
+	for (size_t i = 0; i < video->num_convert_threads; i++) {
+		struct obs_convert_thread *ct = &video->convert_threads[i];
+
+		os_sem_post(ct->start_sem);
+		pthread_join(ct->thread, NULL);
+		os_sem_destroy(ct->start_sem);
+		ct->start_sem = NULL;
+	}
+
+	os_sem_destroy(video->convert_done_sem);
+	video->convert_done_sem    = NULL;
+	video->num_convert_threads = 0;
+	video->convert_stop        = false;
+}
+
 static int obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -345,6 +424,8 @@ static int obs_init_video(struct obs_video_info *ovi)
 	video->output_height  = ovi->output_height;
 	video->gpu_conversion = ovi->gpu_conversion;
 	video->scale_type     = ovi->scale_type;
+	video->num_textures   = (int)ovi->num_textures;
+	video->offline        = ovi->offline;
 
 	set_video_matrix(video, ovi);
 
@@ -360,6 +441,17 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	}
 
+	if (pthread_mutex_init(&video->lent_surfaces_mutex, NULL) != 0)
+		return OBS_VIDEO_FAIL;
+	if (pthread_mutex_init(&video->copy_mutex, NULL) != 0)
+		return OBS_VIDEO_FAIL;
+	if (pthread_mutex_init(&video->renditions_mutex, NULL) != 0)
+		return OBS_VIDEO_FAIL;
+	if (os_sem_init(&video->copy_sem, 0) != 0)
+		return OBS_VIDEO_FAIL;
+	if (os_event_init(&video->surface_returned, OS_EVENT_TYPE_AUTO) != 0)
+		return OBS_VIDEO_FAIL;
+
 	if (!obs_display_init(&video->main_display, NULL))
 		return OBS_VIDEO_FAIL;
 
@@ -375,6 +467,16 @@ static int obs_init_video(struct obs_video_info *ovi)
 
 	gs_leave_context();
 
+	if (!obs_init_convert_threads(ovi))
+		return OBS_VIDEO_FAIL;
+
+	errorcode = pthread_create(&video->copy_thread, NULL,
+			obs_copy_thread, obs);
+	if (errorcode != 0)
+		return OBS_VIDEO_FAIL;
+
+	video->copy_thread_initialized = true;
+
 	errorcode = pthread_create(&video->video_thread, NULL,
 			obs_video_thread, obs);
 	if (errorcode != 0)
@@ -391,10 +493,19 @@ static void stop_video(void)
 
 	if (video->video) {
 		video_output_stop(video->video);
+		if (video->surface_returned)
+			os_event_signal(video->surface_returned);
 		if (video->thread_initialized) {
 			pthread_join(video->video_thread, &thread_retval);
 			video->thread_initialized = false;
 		}
+		if (video->copy_thread_initialized) {
+			video->copy_stop = true;
+			os_sem_post(video->copy_sem);
+			pthread_join(video->copy_thread, &thread_retval);
+			video->copy_thread_initialized = false;
+			video->copy_stop = false;
+		}
 	}
 
 }
@@ -404,8 +515,10 @@ static void obs_free_video(void)
 	struct obs_core_video *video = &obs->video;
 
 	if (video->video) {
+		obs_free_convert_threads();
 		obs_display_free(&video->main_display);
 
+		/* closing the output returns any lent surfaces */
 		video_output_close(video->video);
 		video->video = NULL;
 
@@ -414,12 +527,19 @@ static void obs_free_video(void)
 
 		gs_enter_context(video->graphics);
 
-		if (video->mapped_surface) {
-			gs_stagesurface_unmap(video->mapped_surface);
-			video->mapped_surface = NULL;
+		for (size_t i = 0; i < video->returned_surfaces.num; i++) {
+			gs_stagesurf_t *surface =
+				video->returned_surfaces.array[i];
+			gs_stagesurface_unmap(surface);
+			gs_stagesurface_destroy(surface);
 		}
+		for (size_t i = 0; i < video->spare_surfaces.num; i++)
+			gs_stagesurface_destroy(video->spare_surfaces.array[i]);
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < video->renditions.num; i++)
+			obs_rendition_destroy(video->renditions.array[i]);
+
+		for (size_t i = 0; i < (size_t)video->num_textures; i++) {
 			gs_stagesurface_destroy(video->copy_surfaces[i]);
 			gs_texture_destroy(video->render_textures[i]);
 			gs_texture_destroy(video->convert_textures[i]);
@@ -434,6 +554,17 @@ static void obs_free_video(void)
 		gs_leave_context();
 
 		circlebuf_free(&video->vframe_info_buffer);
+		da_free(video->returned_surfaces);
+		da_free(video->spare_surfaces);
+		da_free(video->renditions);
+		pthread_mutex_destroy(&video->renditions_mutex);
+		circlebuf_free(&video->copy_queue);
+		os_sem_destroy(video->copy_sem);
+		video->copy_sem = NULL;
+		os_event_destroy(video->surface_returned);
+		video->surface_returned = NULL;
+		pthread_mutex_destroy(&video->copy_mutex);
+		pthread_mutex_destroy(&video->lent_surfaces_mutex);
 
 		memset(&video->textures_rendered, 0,
 				sizeof(video->textures_rendered));
@@ -527,8 +658,12 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&data->services_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->volmeters_mutex, &attr) != 0)
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
+	if (!obs_frame_pool_init(&data->frame_pool))
+		goto fail;
 
 	data->valid = true;
 
@@ -584,12 +719,23 @@ static void obs_free_data(void)
 	FREE_OBS_LINKED_LIST(display);
 	FREE_OBS_LINKED_LIST(service);
 
+	obs_frame_pool_free(&data->frame_pool);
+
 	pthread_mutex_destroy(&data->user_sources_mutex);
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->displays_mutex);
 	pthread_mutex_destroy(&data->outputs_mutex);
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
+
+	if (data->volmeters.num)
+		blog(LOG_INFO, "\t%d volume meter(s) were remaining",
+				(int)data->volmeters.num);
+
+	da_free(data->volmeters);
+	da_free(data->volmeter_callbacks);
+	da_free(data->volmeter_levels);
+	pthread_mutex_destroy(&data->volmeters_mutex);
 }
 
 static const char *obs_signals[] = {
@@ -834,6 +980,24 @@ const char *obs_get_locale(void)
 #define OBS_SIZE_MIN 2
 #define OBS_SIZE_MAX (32 * 1024)
 
+static bool renditions_active(void)
+{
+	struct obs_core_video *video = &obs->video;
+	bool active = false;
+
+	if (!video->video)
+		return false;
+
+	pthread_mutex_lock(&video->renditions_mutex);
+	for (size_t i = 0; i < video->renditions.num; i++) {
+		if (video_output_active(video->renditions.array[i]->video))
+			active = true;
+	}
+	pthread_mutex_unlock(&video->renditions_mutex);
+
+	return active;
+}
+
 static inline bool size_valid(uint32_t width, uint32_t height)
 {
 	return (width >= OBS_SIZE_MIN && height >= OBS_SIZE_MIN &&
@@ -847,6 +1011,8 @@ int obs_reset_video(struct obs_video_info *ovi)
 	/* don't allow changing of video settings if active. */
 	if (obs->video.video && video_output_active(obs->video.video))
 		return OBS_VIDEO_CURRENTLY_ACTIVE;
+	if (renditions_active())
+		return OBS_VIDEO_CURRENTLY_ACTIVE;
 
 	if (!size_valid(ovi->output_width, ovi->output_height) ||
 	    !size_valid(ovi->base_width,   ovi->base_height))
@@ -866,6 +1032,13 @@ int obs_reset_video(struct obs_video_info *ovi)
 	ovi->output_width  &= 0xFFFFFFFC;
 	ovi->output_height &= 0xFFFFFFFE;
 
+	if (ovi->num_textures == 0)
+		ovi->num_textures = DEFAULT_TEXTURES;
+	else if (ovi->num_textures < 2)
+		ovi->num_textures = 2;
+	else if (ovi->num_textures > MAX_TEXTURES)
+		ovi->num_textures = MAX_TEXTURES;
+
 	if (!video->graphics) {
 		int errorcode = obs_init_graphics(ovi);
 		if (errorcode != OBS_VIDEO_SUCCESS) {
@@ -878,11 +1051,14 @@ int obs_reset_video(struct obs_video_info *ovi)
 	               "\tbase resolution:   %dx%d\n"
 	               "\toutput resolution: %dx%d\n"
 	               "\tfps:               %d/%d\n"
-	               "\tformat:            %s",
+	               "\tformat:            %s\n"
+	               "\tgpu buffer frames: %d%s",
 	               ovi->base_width, ovi->base_height,
 	               ovi->output_width, ovi->output_height,
 	               ovi->fps_num, ovi->fps_den,
-		       get_video_format_name(ovi->output_format));
+		       get_video_format_name(ovi->output_format),
+		       (int)ovi->num_textures,
+		       ovi->offline ? "\n\toffline rendering" : "");
 
 	return obs_init_video(ovi);
 }
@@ -906,14 +1082,20 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
 	ai.buffer_ms = oai->buffer_ms;
+	ai.period_ms = oai->period_ms;
+	ai.offline = oai->offline;
 
 	blog(LOG_INFO, "audio settings reset:\n"
 	               "\tsamples per sec: %d\n"
 	               "\tspeakers:        %d\n"
-	               "\tbuffering (ms):  %d\n",
+	               "\tbuffering (ms):  %d\n"
+	               "\tperiod (ms):     %d\n"
+	               "\toffline:         %s\n",
 	               (int)ai.samples_per_sec,
 	               (int)ai.speakers,
-	               (int)ai.buffer_ms);
+	               (int)ai.buffer_ms,
+	               (int)ai.period_ms,
+	               ai.offline ? "true" : "false");
 
 	return obs_init_audio(&ai);
 }
@@ -935,6 +1117,8 @@ bool obs_get_video_info(struct obs_video_info *ovi)
 	ovi->base_height   = video->base_height;
 	ovi->gpu_conversion= video->gpu_conversion;
 	ovi->scale_type    = video->scale_type;
+	ovi->num_textures  = (uint32_t)video->num_textures;
+	ovi->offline       = video->offline;
 	ovi->colorspace    = info->colorspace;
 	ovi->range         = info->range;
 	ovi->output_width  = info->width;
@@ -959,6 +1143,8 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 	oai->samples_per_sec = info->samples_per_sec;
 	oai->speakers = info->speakers;
 	oai->buffer_ms = info->buffer_ms;
+	oai->period_ms = info->period_ms;
+	oai->offline = info->offline;
 	return true;
 }
 
@@ -1044,6 +1230,138 @@ video_t *obs_get_video(void)
 	return (obs != NULL) ? obs->video.video : NULL;
 }
 
+/* must be called within the graphics context */
+void obs_rendition_destroy(struct obs_rendition *r)
+{
+	for (size_t i = 0; i < MAX_TEXTURES; i++) {
+		if (r->surfaces_out[i])
+			gs_stagesurface_unmap(r->copy_surfaces[i]);
+
+		gs_stagesurface_destroy(r->copy_surfaces[i]);
+		gs_texture_destroy(r->convert_textures[i]);
+		gs_texture_destroy(r->output_textures[i]);
+	}
+
+	video_output_close(r->video);
+	bfree(r);
+}
+
+static bool obs_init_rendition_textures(struct obs_rendition *r)
+{
+	struct obs_core_video *video = &obs->video;
+	uint32_t copy_height = video->gpu_conversion ?
+		r->conversion.conversion_height : r->height;
+
+	for (size_t i = 0; i < (size_t)video->num_textures; i++) {
+		r->copy_surfaces[i] = gs_stagesurface_create(r->width,
+				copy_height, GS_RGBA);
+		if (!r->copy_surfaces[i])
+			return false;
+
+		r->output_textures[i] = gs_texture_create(r->width, r->height,
+				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
+		if (!r->output_textures[i])
+			return false;
+
+		if (!video->gpu_conversion)
+			continue;
+
+		r->convert_textures[i] = gs_texture_create(r->width,
+				copy_height, GS_RGBA, 1, NULL,
+				GS_RENDER_TARGET);
+		if (!r->convert_textures[i])
+			return false;
+	}
+
+	return true;
+}
+
+video_t *obs_add_video_rendition(uint32_t width, uint32_t height)
+{
+	struct obs_core_video *video;
+	const struct video_output_info *main_info;
+	struct video_output_info vi;
+	struct obs_rendition *r;
+	size_t idx;
+	bool success;
+
+	if (!obs || !obs->video.video) return NULL;
+
+	video = &obs->video;
+	main_info = video_output_get_info(video->video);
+
+	/* align to multiple-of-two and SSE alignment sizes */
+	width  &= 0xFFFFFFFC;
+	height &= 0xFFFFFFFE;
+
+	if (!size_valid(width, height))
+		return NULL;
+
+	if (!video->gpu_conversion && format_is_yuv(main_info->format)) {
+		blog(LOG_WARNING, "obs_add_video_rendition: Renditions of "
+		                  "YUV output require GPU conversion");
+		return NULL;
+	}
+
+	r = bzalloc(sizeof(struct obs_rendition));
+	r->width  = width;
+	r->height = height;
+
+	if (video->gpu_conversion)
+		calc_gpu_conversion_sizes(&r->conversion, main_info->format,
+				width, height);
+
+	vi        = *main_info;
+	vi.name   = "rendition";
+	vi.width  = width;
+	vi.height = height;
+
+	if (video_output_open(&r->video, &vi) != VIDEO_OUTPUT_SUCCESS) {
+		bfree(r);
+		return NULL;
+	}
+
+	gs_enter_context(video->graphics);
+	success = obs_init_rendition_textures(r);
+	if (!success)
+		obs_rendition_destroy(r);
+	gs_leave_context();
+
+	if (!success)
+		return NULL;
+
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	for (idx = 0; idx < video->renditions.num; idx++) {
+		if (video->renditions.array[idx]->width < width)
+			break;
+	}
+	da_insert(video->renditions, idx, &r);
+
+	pthread_mutex_unlock(&video->renditions_mutex);
+
+	blog(LOG_INFO, "Added %"PRIu32"x%"PRIu32" video rendition",
+			width, height);
+	return r->video;
+}
+
+void obs_remove_video_rendition(video_t *rendition)
+{
+	struct obs_core_video *video;
+
+	if (!obs || !rendition) return;
+
+	video = &obs->video;
+
+	pthread_mutex_lock(&video->renditions_mutex);
+	for (size_t i = 0; i < video->renditions.num; i++) {
+		struct obs_rendition *r = video->renditions.array[i];
+		if (r->video == rendition)
+			r->removed = true;
+	}
+	pthread_mutex_unlock(&video->renditions_mutex);
+}
+
 /* TODO: optimize this later so it's not just O(N) string lookups */
 static inline struct obs_modal_ui *get_modal_ui_callback(const char *id,
 		const char *task, const char *target)
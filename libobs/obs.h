@@ -176,6 +176,20 @@ struct obs_video_info {
 	enum video_range_type range;       /**< YUV range (if YUV) */
 
 	enum obs_scale_type scale_type;    /**< How to scale if scaling */
+
+	/**
+	 * Number of frames buffered on the GPU before the output is read back
+	 * (2-5, 0 for the default of 2).  Higher values add latency, but give
+	 * the driver more time to finish the readback before it's mapped.
+	 */
+	uint32_t            num_textures;
+
+	/**
+	 * Render as fast as possible on a virtual clock instead of in real
+	 * time, waiting for outputs rather than dropping frames.  Should be
+	 * used together with obs_audio_info::offline.
+	 */
+	bool                offline;
 };
 
 /**
@@ -185,6 +199,15 @@ struct obs_audio_info {
 	uint32_t            samples_per_sec;
 	enum speaker_layout speakers;
 	uint64_t            buffer_ms;
+
+	/**
+	 * Audio mixing period in milliseconds.  Lower values reduce latency
+	 * at the cost of more frequent wakeups.  0 uses the default (25ms).
+	 */
+	uint32_t            period_ms;
+
+	/** Mix audio on the video clock instead of in real time */
+	bool                offline;
 };
 
 /**
@@ -440,6 +463,20 @@ EXPORT audio_t *obs_get_audio(void);
 /** Gets the main video output handler for this OBS context */
 EXPORT video_t *obs_get_video(void);
 
+/**
+ * Adds an additional output of the main view at a different resolution, in
+ * the same format as the main output.  Renditions are scaled and converted
+ * on the GPU, each from the next largest, so they can feed an adaptive
+ * bitrate ladder of encoders without CPU scaling.  Requires GPU conversion
+ * unless the output format is RGB.
+ *
+ * @return  The video output to give to the encoders, or NULL on failure
+ */
+EXPORT video_t *obs_add_video_rendition(uint32_t width, uint32_t height);
+
+/** Removes a rendition added with obs_add_video_rendition */
+EXPORT void obs_remove_video_rendition(video_t *rendition);
+
 /**
  * Adds a source to the user source list and increments the reference counter
  * for that source.
@@ -817,6 +854,15 @@ EXPORT void obs_source_load(obs_source_t *source);
 #define OBS_SOURCE_FLAG_UNBUFFERED             (1<<0)
 /** Specifies to force audio to mono */
 #define OBS_SOURCE_FLAG_FORCE_MONO             (1<<1)
+/**
+ * Specifies that the rendered video of the source should be cached for the
+ * rest of the frame, so that drawing the source more than once per frame
+ * (e.g. when it is used in several scenes or scene items) only renders it
+ * and its filters once.  Costs an extra texture and render pass, so it is
+ * only worth setting on sources that are expensive to render and are
+ * actually used more than once.
+ */
+#define OBS_SOURCE_FLAG_CACHE_RENDER           (1<<2)
 
 /**
  * Sets source flags.  Note that these are different from the main output
@@ -837,6 +883,31 @@ EXPORT void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers);
 /** Gets audio mixer flags */
 EXPORT uint32_t obs_source_get_audio_mixers(const obs_source_t *source);
 
+/**
+ * Audio capture callback.  Receives the audio of the source after filtering,
+ * with the volume of the source set in the audio data.  If muted is true the
+ * volume will be 0.  Called from the thread that outputs the audio of the
+ * source, so it should return quickly.
+ */
+typedef void (*obs_source_audio_capture_t)(void *param, obs_source_t *source,
+		const struct audio_data *audio_data, bool muted);
+
+/**
+ * Adds an audio capture callback to a source.  Replaces the "audio_data"
+ * signal, which is deprecated and will be removed; sources with no capture
+ * callbacks do not pay anything for it.
+ */
+EXPORT void obs_source_add_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param);
+
+/**
+ * Removes an audio capture callback from a source.  Can be called from within
+ * a capture callback, a callback removed while it is being called is not
+ * called again.
+ */
+EXPORT void obs_source_remove_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param);
+
 /**
  * Increments the 'showing' reference counter to indicate that the source is
  * being shown somewhere.  If the reference counter was 0, will call the 'show'
@@ -917,6 +988,26 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/** Called when libobs no longer needs the data of an owned frame */
+typedef void (*obs_source_frame_release_t)(void *param);
+
+/**
+ * Outputs asynchronous video data without copying it.
+ *
+ * Unlike obs_source_output_video, the frame data is not copied; libobs keeps
+ * using the data the frame points to until it calls the release callback,
+ * after which the data belongs to the caller again (for example to requeue a
+ * capture buffer or to free a decoded frame).  The frame structure itself is
+ * copied and does not need to stay valid.
+ *
+ * The release callback is always called exactly once, possibly before this
+ * function returns (e.g. if the frame is dropped), and may be called from the
+ * graphics thread.
+ */
+EXPORT void obs_source_output_video_owned(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		obs_source_frame_release_t release, void *param);
+
 /** Outputs audio data (always asynchronous) */
 EXPORT void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio);
@@ -1553,6 +1644,17 @@ static inline void obs_source_frame_destroy(struct obs_source_frame *frame)
 	}
 }
 
+/**
+ * Sets the maximum amount of memory (in bytes) libobs keeps in idle async
+ * frames.  Idle frames are shared between all sources that output frames of
+ * the same format and size, and the least recently used frames are freed
+ * first when the limit is exceeded.  A limit of 0 disables reuse.
+ */
+EXPORT void obs_set_async_frame_pool_limit(uint64_t bytes);
+
+/** Gets the maximum amount of memory kept in idle async frames */
+EXPORT uint64_t obs_get_async_frame_pool_limit(void);
+
 
 #ifdef __cplusplus
 }
@@ -177,6 +177,13 @@ void os_sleep_ms(uint32_t duration)
 	Sleep(duration);
 }
 
+int os_get_logical_cores(void)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return (int)si.dwNumberOfProcessors;
+}
+
 uint64_t os_gettime_ns(void)
 {
 	LARGE_INTEGER current_time;
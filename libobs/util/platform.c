@@ -24,6 +24,17 @@
 #include "bmem.h"
 #include "utf8.h"
 #include "dstr.h"
+#include "threading.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+    defined(__x86_64__)
+#define OS_CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
 
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
@@ -508,3 +519,79 @@ int os_dtostr(double value, char *dst, size_t size)
 
 	return (int)length;
 }
+
+#ifdef OS_CPU_X86
+static inline void get_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static inline uint64_t get_xcr0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t query_cpu_features(void)
+{
+	uint32_t regs[4];
+	uint32_t features = 0;
+	uint32_t max_leaf;
+	bool     os_avx;
+
+	get_cpuid(0, 0, regs);
+	max_leaf = regs[0];
+	if (max_leaf < 1)
+		return 0;
+
+	get_cpuid(1, 0, regs);
+	if (regs[3] & (1<<26))
+		features |= OS_CPU_SSE2;
+	if (regs[2] & (1<<19))
+		features |= OS_CPU_SSE4_1;
+
+	/* AVX state must also be saved/restored by the OS (OSXSAVE + XCR0) */
+	os_avx = (regs[2] & (1<<27)) && (regs[2] & (1<<28)) &&
+		(get_xcr0() & 0x6) == 0x6;
+	if (!os_avx)
+		return features;
+
+	features |= OS_CPU_AVX;
+
+	if (max_leaf >= 7) {
+		get_cpuid(7, 0, regs);
+		if (regs[1] & (1<<5))
+			features |= OS_CPU_AVX2;
+	}
+
+	return features;
+}
+#else
+static uint32_t query_cpu_features(void)
+{
+	return 0;
+}
+#endif
+
+static pthread_once_t cpu_features_once = PTHREAD_ONCE_INIT;
+static uint32_t       cpu_features       = 0;
+
+static void init_cpu_features(void)
+{
+	cpu_features = query_cpu_features();
+}
+
+uint32_t os_get_cpu_features(void)
+{
+	pthread_once(&cpu_features_once, init_cpu_features);
+	return cpu_features;
+}
@@ -93,6 +93,20 @@ EXPORT void os_sleep_ms(uint32_t duration);
 
 EXPORT uint64_t os_gettime_ns(void);
 
+#define OS_CPU_SSE2   (1<<0)
+#define OS_CPU_SSE4_1 (1<<1)
+#define OS_CPU_AVX    (1<<2)
+#define OS_CPU_AVX2   (1<<3)
+
+/**
+ * Returns the SIMD instruction sets (OS_CPU_*) supported by both the CPU and
+ * the operating system.  The result is computed once and then cached.
+ */
+EXPORT uint32_t os_get_cpu_features(void);
+
+/** Returns the number of logical processors available to the process */
+EXPORT int os_get_logical_cores(void);
+
 EXPORT int os_get_config_path(char *dst, size_t size, const char *name);
 EXPORT char *os_get_config_path_ptr(const char *name);
 
@@ -19,6 +19,7 @@
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <intrin.h>
 
 #ifdef __MINGW32__
 #include <excpt.h>
@@ -176,11 +177,31 @@ long os_atomic_dec_long(volatile long *val)
 	return InterlockedDecrement(val);
 }
 
+long os_atomic_set_long(volatile long *ptr, long val)
+{
+	return InterlockedExchange(ptr, val);
+}
+
+long os_atomic_load_long(const volatile long *ptr)
+{
+	return InterlockedCompareExchange((volatile long*)ptr, 0, 0);
+}
+
 bool os_atomic_compare_swap_long(volatile long *val, long old_val, long new_val)
 {
 	return InterlockedCompareExchange(val, new_val, old_val) == old_val;
 }
 
+bool os_atomic_set_bool(volatile bool *ptr, bool val)
+{
+	return !!_InterlockedExchange8((volatile char*)ptr, (char)val);
+}
+
+bool os_atomic_load_bool(const volatile bool *ptr)
+{
+	return !!_InterlockedOr8((volatile char*)ptr, 0);
+}
+
 #define VC_EXCEPTION 0x406D1388
 
 #pragma pack(push,8)
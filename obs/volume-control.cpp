@@ -11,11 +11,18 @@
 #include <QLabel>
 #include <QPainter>
 #include <QTimer>
+#include <QMutex>
+#include <QHash>
 #include <string>
 #include <math.h>
 
 using namespace std;
 
+/* all volume controls share one batched levels callback, it looks up the
+ * control of each updated volume meter here */
+static QMutex volControlsMutex;
+static QHash<obs_volmeter_t*, VolControl*> volControls;
+
 void VolControl::OBSVolumeChanged(void *data, calldata_t *calldata)
 {
 	Q_UNUSED(calldata);
@@ -24,19 +31,25 @@ void VolControl::OBSVolumeChanged(void *data, calldata_t *calldata)
 	QMetaObject::invokeMethod(volControl, "VolumeChanged");
 }
 
-void VolControl::OBSVolumeLevel(void *data, calldata_t *calldata)
+void VolControl::OBSVolumeLevels(void *param,
+		const struct obs_volmeter_levels *levels, size_t count)
 {
-	VolControl *volControl = static_cast<VolControl*>(data);
-	float peak      = calldata_float(calldata, "level");
-	float mag       = calldata_float(calldata, "magnitude");
-	float peakHold  = calldata_float(calldata, "peak");
-	bool  muted     = calldata_bool (calldata, "muted");
-
-	QMetaObject::invokeMethod(volControl, "VolumeLevel",
-		Q_ARG(float, mag),
-		Q_ARG(float, peak),
-		Q_ARG(float, peakHold),
-		Q_ARG(bool,  muted));
+	Q_UNUSED(param);
+	QMutexLocker locker(&volControlsMutex);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct obs_volmeter_levels &l = levels[i];
+		VolControl *volControl = volControls.value(l.volmeter);
+
+		if (!volControl)
+			continue;
+
+		QMetaObject::invokeMethod(volControl, "VolumeLevel",
+			Q_ARG(float, l.magnitude),
+			Q_ARG(float, l.level),
+			Q_ARG(float, l.peak),
+			Q_ARG(bool,  l.muted));
+	}
 }
 
 void VolControl::OBSVolumeMuted(void *data, calldata_t *calldata)
@@ -177,8 +190,13 @@ VolControl::VolControl(OBSSource source_, bool showConfig)
 	signal_handler_connect(obs_fader_get_signal_handler(obs_fader),
 			"volume_changed", OBSVolumeChanged, this);
 
-	signal_handler_connect(obs_volmeter_get_signal_handler(obs_volmeter),
-			"levels_updated", OBSVolumeLevel, this);
+	volControlsMutex.lock();
+	bool first = volControls.isEmpty();
+	volControls.insert(obs_volmeter, this);
+	volControlsMutex.unlock();
+
+	if (first)
+		obs_add_volmeter_levels_callback(OBSVolumeLevels, nullptr);
 
 	signal_handler_connect(obs_source_get_signal_handler(source),
 			"mute", OBSVolumeMuted, this);
@@ -202,8 +220,13 @@ VolControl::~VolControl()
 	signal_handler_disconnect(obs_fader_get_signal_handler(obs_fader),
 			"volume_changed", OBSVolumeChanged, this);
 
-	signal_handler_disconnect(obs_volmeter_get_signal_handler(obs_volmeter),
-			"levels_updated", OBSVolumeLevel, this);
+	volControlsMutex.lock();
+	volControls.remove(obs_volmeter);
+	bool last = volControls.isEmpty();
+	volControlsMutex.unlock();
+
+	if (last)
+		obs_remove_volmeter_levels_callback(OBSVolumeLevels, nullptr);
 
 	signal_handler_disconnect(obs_source_get_signal_handler(source),
 			"mute", OBSVolumeMuted, this);
@@ -57,7 +57,9 @@ private:
 	obs_volmeter_t  *obs_volmeter;
 
 	static void OBSVolumeChanged(void *param, calldata_t *calldata);
-	static void OBSVolumeLevel(void *data, calldata_t *calldata);
+	static void OBSVolumeLevels(void *param,
+			const struct obs_volmeter_levels *levels,
+			size_t count);
 	static void OBSVolumeMuted(void *data, calldata_t *calldata);
 
 	void EmitConfigClicked();
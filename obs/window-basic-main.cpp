@@ -601,11 +601,14 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "709");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
 			"Partial");
+	config_set_default_uint  (basicConfig, "Video", "GPUBufferFrames", 2);
+	config_set_default_uint  (basicConfig, "Video", "FramePoolMB", 256);
 
 	config_set_default_uint  (basicConfig, "Audio", "SampleRate", 44100);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
 			"Stereo");
 	config_set_default_uint  (basicConfig, "Audio", "BufferingTime", 1000);
+	config_set_default_uint  (basicConfig, "Audio", "PeriodMs", 0);
 
 	config_set_default_string(basicConfig, "Audio", "DesktopDevice1",
 			hasDesktopAudio ? "default" : "disabled");
@@ -1856,6 +1859,9 @@ int OBSBasic::ResetVideo()
 	ovi.adapter        = 0;
 	ovi.gpu_conversion = true;
 	ovi.scale_type     = GetScaleType(basicConfig);
+	ovi.num_textures   = (uint32_t)config_get_uint(basicConfig,
+			"Video", "GPUBufferFrames");
+	ovi.offline        = false;
 
 	QTToGSWindow(ui->preview->winId(), ovi.window);
 
@@ -1866,6 +1872,10 @@ int OBSBasic::ResetVideo()
 	ovi.window_width  = size.width();
 	ovi.window_height = size.height();
 
+	uint64_t framePoolMB = config_get_uint(basicConfig, "Video",
+			"FramePoolMB");
+	obs_set_async_frame_pool_limit(framePoolMB * 1024 * 1024);
+
 	ret = AttemptToResetVideo(&ovi);
 	if (IS_WIN32 && ret != OBS_VIDEO_SUCCESS) {
 		/* Try OpenGL if DirectX fails on windows */
@@ -1901,6 +1911,9 @@ bool OBSBasic::ResetAudio()
 		ai.speakers = SPEAKERS_STEREO;
 
 	ai.buffer_ms = config_get_uint(basicConfig, "Audio", "BufferingTime");
+	ai.period_ms = (uint32_t)config_get_uint(basicConfig, "Audio",
+			"PeriodMs");
+	ai.offline = false;
 
 	return obs_reset_audio(&ai);
 }
@@ -223,20 +223,47 @@ static bool video_frame_hwaccel(struct ff_frame *frame,
 	return true;
 }
 
+static void release_av_frame(void *param)
+{
+	AVFrame *frame = param;
+	av_frame_free(&frame);
+}
+
 static bool video_frame_direct(struct ff_frame *frame,
 		struct ffmpeg_source *s, struct obs_source_frame *obs_frame)
 {
+	AVFrame *ref;
 	int i;
 
-	for (i = 0; i < MAX_AV_PLANES; i++) {
-		obs_frame->data[i] = frame->frame->data[i];
-		obs_frame->linesize[i] = frame->frame->linesize[i];
+	if (!set_obs_frame_colorprops(frame, obs_frame))
+		return false;
+
+	/* libobs uploads 4:2:0 and NV12 as one contiguous block, which decoder
+	 * buffers almost never are, so it would copy those anyway */
+	if (obs_frame->format == VIDEO_FORMAT_I420 ||
+	    obs_frame->format == VIDEO_FORMAT_NV12) {
+		for (i = 0; i < MAX_AV_PLANES; i++) {
+			obs_frame->data[i] = frame->frame->data[i];
+			obs_frame->linesize[i] = frame->frame->linesize[i];
+		}
+
+		obs_source_output_video(s->source, obs_frame);
+		return true;
 	}
 
-	if (!set_obs_frame_colorprops(frame, obs_frame))
+	/* hand libobs a reference to the decoded frame so that it can use the
+	 * decoder's buffers directly instead of copying them */
+	ref = av_frame_clone(frame->frame);
+	if (!ref)
 		return false;
 
-	obs_source_output_video(s->source, obs_frame);
+	for (i = 0; i < MAX_AV_PLANES; i++) {
+		obs_frame->data[i] = ref->data[i];
+		obs_frame->linesize[i] = ref->linesize[i];
+	}
+
+	obs_source_output_video_owned(s->source, obs_frame,
+			release_av_frame, ref);
 	return true;
 }
 
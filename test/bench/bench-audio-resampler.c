@@ -0,0 +1,256 @@
+/*
+ * Compares the native audio resampler against libswresample, with the same
+ * filter settings libobs used swr with (the swr defaults).
+ *
+ * For each conversion a pure tone is resampled in 1024 frame chunks, the
+ * size libobs outputs audio in.  Quality is the SNR of the output against
+ * the best fitting sine of the tone's frequency, throughput is how many
+ * seconds of audio are converted per second.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <libswresample/swresample.h>
+#include <libavutil/opt.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-resampler-native.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#define CHUNK_FRAMES  1024
+#define QUALITY_SECS  2
+#define SPEED_SECS    60
+
+/* skip the filter's start-up so it does not count as noise */
+#define SETTLE_FRAMES 4096
+
+struct conversion {
+	uint32_t src_rate;
+	uint32_t dst_rate;
+	double   freq;
+};
+
+static const struct conversion conversions[] = {
+	{44100, 48000,  1000.0},
+	{44100, 48000, 15000.0},
+	{48000, 44100,  1000.0},
+	{48000, 44100, 15000.0},
+	{32000, 48000,  1000.0},
+	{96000, 48000,  1000.0},
+};
+
+#define NUM_CONVERSIONS (sizeof(conversions) / sizeof(conversions[0]))
+
+struct resampler {
+	const char              *name;
+	struct native_resampler *native;
+	struct SwrContext       *swr;
+	float                   *swr_out[2];
+	int                     swr_out_size;
+};
+
+static bool resampler_init(struct resampler *rs, bool native,
+		uint32_t src_rate, uint32_t dst_rate)
+{
+	struct resample_info src = {src_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+		SPEAKERS_STEREO};
+	struct resample_info dst = {dst_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+		SPEAKERS_STEREO};
+
+	memset(rs, 0, sizeof(*rs));
+
+	if (native) {
+		rs->name   = "native";
+		rs->native = native_resampler_create(&dst, &src);
+		return rs->native != NULL;
+	}
+
+	rs->name = "swr";
+	rs->swr  = swr_alloc();
+	if (!rs->swr)
+		return false;
+
+#if LIBSWRESAMPLE_VERSION_INT >= AV_VERSION_INT(4, 5, 100)
+	av_opt_set(rs->swr, "in_chlayout",  "stereo", 0);
+	av_opt_set(rs->swr, "out_chlayout", "stereo", 0);
+#else
+	av_opt_set_int(rs->swr, "in_channel_layout",  AV_CH_LAYOUT_STEREO, 0);
+	av_opt_set_int(rs->swr, "out_channel_layout", AV_CH_LAYOUT_STEREO, 0);
+#endif
+	av_opt_set_int(rs->swr, "in_sample_rate",  src_rate, 0);
+	av_opt_set_int(rs->swr, "out_sample_rate", dst_rate, 0);
+	av_opt_set_sample_fmt(rs->swr, "in_sample_fmt",  AV_SAMPLE_FMT_FLTP, 0);
+	av_opt_set_sample_fmt(rs->swr, "out_sample_fmt", AV_SAMPLE_FMT_FLTP, 0);
+
+	rs->swr_out_size = CHUNK_FRAMES * 4;
+	rs->swr_out[0]   = bmalloc(rs->swr_out_size * sizeof(float));
+	rs->swr_out[1]   = bmalloc(rs->swr_out_size * sizeof(float));
+
+	return swr_init(rs->swr) == 0;
+}
+
+static void resampler_free(struct resampler *rs)
+{
+	native_resampler_destroy(rs->native);
+	swr_free(&rs->swr);
+	bfree(rs->swr_out[0]);
+	bfree(rs->swr_out[1]);
+}
+
+static uint32_t resampler_run(struct resampler *rs, const float *in[2],
+		uint32_t frames, const float **out)
+{
+	if (rs->native) {
+		uint8_t  *output[MAX_AV_PLANES];
+		uint32_t out_frames;
+		uint64_t ts_offset;
+
+		native_resampler_resample(rs->native, output, &out_frames,
+				&ts_offset, (const uint8_t *const *)in,
+				frames);
+		*out = (const float*)output[0];
+		return out_frames;
+
+	} else {
+		int ret = swr_convert(rs->swr, (uint8_t**)rs->swr_out,
+				rs->swr_out_size, (const uint8_t**)in,
+				(int)frames);
+		*out = rs->swr_out[0];
+		return ret > 0 ? (uint32_t)ret : 0;
+	}
+}
+
+static void fill_tone(float *buf, size_t frames, size_t offset,
+		double freq, uint32_t rate)
+{
+	for (size_t i = 0; i < frames; i++)
+		buf[i] = (float)(0.5 * sin(2.0 * M_PI * freq *
+				(double)(offset + i) / (double)rate));
+}
+
+/* fits a*sin + b*cos + c of the given frequency to the signal and returns the
+ * ratio of the fitted sine's power to the residual in dB */
+static double tone_snr(const float *buf, size_t frames, double freq,
+		uint32_t rate)
+{
+	double ss = 0.0, cc = 0.0, sc = 0.0, sy = 0.0, cy = 0.0;
+	double a, b, det, signal = 0.0, noise = 0.0;
+
+	for (size_t i = 0; i < frames; i++) {
+		double t = 2.0 * M_PI * freq * (double)i / (double)rate;
+		double s = sin(t), c = cos(t);
+
+		ss += s * s; cc += c * c; sc += s * c;
+		sy += s * buf[i]; cy += c * buf[i];
+	}
+
+	det = ss * cc - sc * sc;
+	a   = (sy * cc - cy * sc) / det;
+	b   = (cy * ss - sy * sc) / det;
+
+	for (size_t i = 0; i < frames; i++) {
+		double t   = 2.0 * M_PI * freq * (double)i / (double)rate;
+		double fit = a * sin(t) + b * cos(t);
+		double err = buf[i] - fit;
+
+		signal += fit * fit;
+		noise  += err * err;
+	}
+
+	return 10.0 * log10(signal / (noise > 0.0 ? noise : 1e-30));
+}
+
+static double measure_quality(struct resampler *rs,
+		const struct conversion *conv)
+{
+	size_t total  = (size_t)conv->src_rate * QUALITY_SECS;
+	float  *in    = bmalloc(CHUNK_FRAMES * sizeof(float));
+	float  *out   = bmalloc((size_t)conv->dst_rate * (QUALITY_SECS + 1) *
+			sizeof(float));
+	const float *planes[2] = {in, in};
+	size_t out_frames = 0;
+	double snr;
+
+	for (size_t pos = 0; pos + CHUNK_FRAMES <= total; pos += CHUNK_FRAMES) {
+		const float *res;
+		uint32_t     n;
+
+		fill_tone(in, CHUNK_FRAMES, pos, conv->freq, conv->src_rate);
+		n = resampler_run(rs, planes, CHUNK_FRAMES, &res);
+		memcpy(out + out_frames, res, n * sizeof(float));
+		out_frames += n;
+	}
+
+	snr = tone_snr(out + SETTLE_FRAMES, out_frames - SETTLE_FRAMES,
+			conv->freq, conv->dst_rate);
+
+	bfree(in);
+	bfree(out);
+	return snr;
+}
+
+static double measure_speed(struct resampler *rs,
+		const struct conversion *conv)
+{
+	size_t   total = (size_t)conv->src_rate * SPEED_SECS;
+	float    *in   = bmalloc(CHUNK_FRAMES * sizeof(float));
+	const float *planes[2] = {in, in};
+	uint64_t start;
+	double   secs;
+
+	fill_tone(in, CHUNK_FRAMES, 0, conv->freq, conv->src_rate);
+
+	start = os_gettime_ns();
+	for (size_t pos = 0; pos + CHUNK_FRAMES <= total; pos += CHUNK_FRAMES) {
+		const float *res;
+		resampler_run(rs, planes, CHUNK_FRAMES, &res);
+	}
+	secs = (double)(os_gettime_ns() - start) / 1000000000.0;
+
+	bfree(in);
+	return (double)SPEED_SECS / secs;
+}
+
+int main(void)
+{
+	printf("%-16s %-8s %10s %14s\n", "conversion", "", "snr (dB)",
+			"x realtime");
+
+	for (size_t i = 0; i < NUM_CONVERSIONS; i++) {
+		const struct conversion *conv = &conversions[i];
+
+		for (int native = 1; native >= 0; native--) {
+			struct resampler rs;
+			char name[32];
+
+			snprintf(name, sizeof(name), "%u->%u %gk",
+					conv->src_rate, conv->dst_rate,
+					conv->freq / 1000.0);
+
+			if (!resampler_init(&rs, native != 0, conv->src_rate,
+						conv->dst_rate)) {
+				printf("%-16s %-8s %10s\n", name, rs.name,
+						"unsupported");
+				resampler_free(&rs);
+				continue;
+			}
+
+			printf("%-16s %-8s %10.1f", name, rs.name,
+					measure_quality(&rs, conv));
+			resampler_free(&rs);
+
+			resampler_init(&rs, native != 0, conv->src_rate,
+					conv->dst_rate);
+			printf(" %14.0f\n", measure_speed(&rs, conv));
+			resampler_free(&rs);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * Checks the SIMD frame decompression kernels against the scalar ones and
+ * compares their speed.
+ *
+ * Every kernel the CPU supports has to produce exactly the scalar output for
+ * a range of widths, including odd widths and widths that leave columns
+ * after the last full vector.  The process exits with an error otherwise.
+ * Speed is measured on 1920x1080 frames.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion-internal.h>
+
+#define BENCH_WIDTH  1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 200
+
+typedef void (*planar_func_t)(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize);
+
+typedef void (*packed_func_t)(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y, uint32_t width,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum);
+
+struct kernels {
+	const char    *name;
+	uint32_t      features;
+	planar_func_t decompress_420;
+	planar_func_t decompress_nv12;
+	packed_func_t decompress_422;
+};
+
+static const struct kernels kernels[] = {
+	{"scalar", 0,
+		decompress_420_c, decompress_nv12_c, decompress_422_c},
+	{"sse2", OS_CPU_SSE2,
+		decompress_420_sse2, decompress_nv12_sse2,
+		decompress_422_sse2},
+	{"avx2", OS_CPU_AVX2,
+		decompress_420_avx2, decompress_nv12_avx2,
+		decompress_422_avx2},
+};
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+enum conversion {
+	CONVERSION_420,
+	CONVERSION_NV12,
+	CONVERSION_YUY2,
+	CONVERSION_UYVY,
+};
+
+static const char *conversion_names[] = {"i420", "nv12", "yuy2", "uyvy"};
+
+#define NUM_CONVERSIONS 4
+
+struct frame {
+	uint32_t width;
+	uint32_t height;
+	uint8_t  *planes[3];
+	uint32_t linesize[3];
+	uint8_t  *packed;
+	uint32_t packed_linesize;
+	uint8_t  *output;
+	uint32_t out_linesize;
+};
+
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)rand();
+}
+
+static void frame_init(struct frame *frame, uint32_t width, uint32_t height)
+{
+	uint32_t even_width  = (width + 1) & ~1;
+	uint32_t even_height = (height + 1) & ~1;
+
+	frame->width            = width;
+	frame->height           = height;
+	frame->linesize[0]      = width;
+	frame->linesize[1]      = even_width / 2;
+	frame->linesize[2]      = even_width / 2;
+	frame->packed_linesize  = even_width * 2;
+	frame->out_linesize     = width * 4;
+
+	frame->planes[0] = bmalloc(width * even_height);
+	frame->planes[1] = bmalloc(even_width * even_height / 2);
+	frame->planes[2] = bmalloc(even_width * even_height / 4);
+	frame->packed    = bmalloc(frame->packed_linesize * height);
+	frame->output    = bmalloc(frame->out_linesize * height);
+
+	fill_random(frame->planes[0], width * even_height);
+	fill_random(frame->planes[1], even_width * even_height / 2);
+	fill_random(frame->planes[2], even_width * even_height / 4);
+	fill_random(frame->packed, frame->packed_linesize * height);
+}
+
+static void frame_free(struct frame *frame)
+{
+	for (size_t i = 0; i < 3; i++)
+		bfree(frame->planes[i]);
+	bfree(frame->packed);
+	bfree(frame->output);
+}
+
+static void run(const struct kernels *k, enum conversion conv,
+		struct frame *frame)
+{
+	const uint8_t *const planes[3] = {
+		frame->planes[0], frame->planes[1], frame->planes[2]
+	};
+	/* nv12 has a single chroma plane of interleaved U/V pairs */
+	const uint32_t nv12_linesize[2] = {
+		frame->linesize[0], frame->linesize[1] * 2
+	};
+
+	switch (conv) {
+	case CONVERSION_420:
+		k->decompress_420(planes, frame->linesize, 0, frame->height,
+				frame->width, frame->output,
+				frame->out_linesize);
+		break;
+	case CONVERSION_NV12:
+		k->decompress_nv12(planes, nv12_linesize, 0, frame->height,
+				frame->width, frame->output,
+				frame->out_linesize);
+		break;
+	case CONVERSION_YUY2:
+	case CONVERSION_UYVY:
+		k->decompress_422(frame->packed, frame->packed_linesize, 0,
+				frame->height, frame->width, frame->output,
+				frame->out_linesize, conv == CONVERSION_YUY2);
+		break;
+	}
+}
+
+static bool check_kernel(const struct kernels *k, enum conversion conv)
+{
+	static const uint32_t widths[] = {
+		1, 2, 3, 15, 16, 17, 31, 33, 63, 65, 1279, 1281, 1921
+	};
+	static const uint32_t heights[] = {2, 7};
+	bool success = true;
+
+	for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+		for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]);
+				h++) {
+			struct frame frame;
+			uint8_t *expected;
+			size_t size;
+
+			frame_init(&frame, widths[w], heights[h]);
+			size = frame.out_linesize * frame.height;
+
+			memset(frame.output, 0xCD, size);
+			run(&kernels[0], conv, &frame);
+			expected = bmemdup(frame.output, size);
+
+			memset(frame.output, 0xCD, size);
+			run(k, conv, &frame);
+
+			if (memcmp(expected, frame.output, size) != 0) {
+				printf("MISMATCH: %s %s at %ux%u\n", k->name,
+						conversion_names[conv],
+						widths[w], heights[h]);
+				success = false;
+			}
+
+			bfree(expected);
+			frame_free(&frame);
+		}
+	}
+
+	return success;
+}
+
+static double bench_kernel(const struct kernels *k, enum conversion conv)
+{
+	struct frame frame;
+	uint64_t start;
+
+	frame_init(&frame, BENCH_WIDTH, BENCH_HEIGHT);
+
+	run(k, conv, &frame);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		run(k, conv, &frame);
+
+	frame_free(&frame);
+
+	return (double)(os_gettime_ns() - start) / 1000000.0 / BENCH_FRAMES;
+}
+
+int main(void)
+{
+	uint32_t features = os_get_cpu_features();
+	bool success = true;
+
+	for (size_t i = 1; i < NUM_KERNELS; i++) {
+		if ((features & kernels[i].features) != kernels[i].features)
+			continue;
+
+		for (int conv = 0; conv < NUM_CONVERSIONS; conv++)
+			if (!check_kernel(&kernels[i], conv))
+				success = false;
+	}
+
+	printf("%s\n\n", success ?
+			"all kernels match the scalar output" :
+			"some kernels do not match the scalar output");
+
+	printf("%-6s %-8s %14s %10s\n", "format", "kernel", "ms per frame",
+			"speedup");
+
+	for (int conv = 0; conv < NUM_CONVERSIONS; conv++) {
+		double scalar_ms = 0.0;
+
+		for (size_t i = 0; i < NUM_KERNELS; i++) {
+			double ms;
+
+			if ((features & kernels[i].features) !=
+					kernels[i].features)
+				continue;
+
+			ms = bench_kernel(&kernels[i], conv);
+			if (i == 0)
+				scalar_ms = ms;
+
+			printf("%-6s %-8s %14.3f %9.2fx\n",
+					conversion_names[conv],
+					kernels[i].name, ms, scalar_ms / ms);
+		}
+	}
+
+	return success ? 0 : 1;
+}
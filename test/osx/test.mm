@@ -54,6 +54,8 @@ static void CreateOBS(NSView *view)
 	ovi.window_width    = cx;
 	ovi.window_height   = cy;
 	ovi.window.view     = view;
+	ovi.num_textures    = 0;
+	ovi.offline         = false;
 
 	if (obs_reset_video(&ovi) != 0)
 		throw "Couldn't initialize video";
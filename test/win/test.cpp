@@ -87,6 +87,8 @@ static void CreateOBS(HWND hwnd)
 	ovi.output_width    = rc.right;
 	ovi.output_height   = rc.bottom;
 	ovi.window.hwnd     = hwnd;
+	ovi.num_textures    = 0;
+	ovi.offline         = false;
 
 	if (obs_reset_video(&ovi) != 0)
 		throw "Couldn't initialize video";